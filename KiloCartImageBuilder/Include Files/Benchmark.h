@@ -0,0 +1,42 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Builder benchmark (synthetic CAS files, phase time and memory usage)      */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __Benchmark_h
+#define __Benchmark_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdbool.h>
+#include <stdint.h>
+#include "FileUtils.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define BENCHMARK_MAX_PHASE_COUNT 16
+#define BENCHMARK_MAX_FILE_LENGTH 0xc000			// program files are loaded into the 48k RAM
+#define BENCHMARK_SAMPLE_INTERVAL 1					// memory sampling interval of the phases (ms)
+
+// Payload types of the synthetic files
+#define BENCHMARK_PAYLOAD_CODE 'c'						// Z80 machine code like content
+#define BENCHMARK_PAYLOAD_SCREEN 's'					// bitmap in the video memory layout
+#define BENCHMARK_PAYLOAD_RANDOM 'r'					// incompressible content
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool BenchmarkCreateFiles(wchar_t* in_directory, int in_file_count, int in_file_length, wchar_t* in_payloads, wchar_t (*out_file_names)[MAX_PATH_LENGTH]);
+void BenchmarkDeleteFiles(wchar_t* in_directory, wchar_t (*in_file_names)[MAX_PATH_LENGTH], int in_file_count);
+
+void BenchmarkStart(void);
+void BenchmarkPhaseStart(const wchar_t* in_name);
+void BenchmarkPhaseEnd(void);
+void BenchmarkPrintReport(void);
+
+#endif
@@ -20,6 +20,8 @@
 #define CASBLOCKHDR_FILE_BUFFERED		0x01
 #define CASBLOCKHDR_FILE_UNBUFFERED	0x11
 
+#define CAS_BLOCK_LENGTH 128					// UPM block length (file length unit of the UPM header)
+
 #define UPMPROGTYPE_PRG		0x01
 #define UPMPROGTYPE_ASCII	0x00
 
@@ -0,0 +1,29 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Z80 machine code filter (position relative CALL/JP/LD HL operands)      */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __CodeFilter_h
+#define __CodeFilter_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdbool.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define CODE_FILTER_INSTRUCTION_LENGTH 3		// opcode and 16 bit operand
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+uint8_t* EncodeCodeFilter(uint8_t* in_data, int in_length);
+bool IsCodeFilterOpcode(uint8_t in_opcode);
+
+#endif
@@ -0,0 +1,40 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Compressibility estimation (pre-screen of the incompressible files)       */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __Compressibility_h
+#define __Compressibility_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdbool.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define COMPRESSIBILITY_MIN_LENGTH 256					// shorter files are always compressed (statistics are not reliable)
+#define COMPRESSIBILITY_MIN_ENTROPY 7.2f				// order-0 entropy of the incompressible files (bits/byte)
+#define COMPRESSIBILITY_MAX_DIGRAM_HITS 0.15f		// digram hit rate of the incompressible files
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	float Order0Entropy;			// bits/byte
+	float Order1Entropy;			// bits/byte, entropy of the bytes in the context of the previous byte
+	float DigramHitRate;			// ratio of the bytes whose digram (with the next byte) occurs in the window before
+	bool Incompressible;			// compression is not expected to make the file shorter
+} CompressibilityEstimate;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool EstimateCompressibility(uint8_t* in_data, int in_length, int in_window_size, CompressibilityEstimate* out_estimate);
+
+#endif
@@ -0,0 +1,49 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Lazy matching parse with a single hash probe (fast compression level)     */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __FastParse_h
+#define __FastParse_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ZX7Compress.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define FAST_MATCH_HASH_LENGTH 3		// Number of bytes used for the hash
+#define FAST_MATCH_HASH_BITS 16
+#define FAST_MATCH_HASH_SIZE (1 << FAST_MATCH_HASH_BITS)
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Match finder which checks only the last position with the same hash
+typedef struct
+{
+	uint8_t* InputData;
+	size_t InputSize;
+	int MaxOffset;
+	size_t Inserted;		// Positions before this one are already in the hash table
+	int* Heads;				// Last position of the hash values (-1 if there is none)
+} FastMatchFinder;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool FastMatchInit(FastMatchFinder* in_finder, uint8_t* in_input_data, size_t in_input_size, int in_max_offset);
+size_t FastMatchFind(FastMatchFinder* in_finder, size_t in_position, size_t in_max_length, int* out_offset);
+void FastMatchFree(FastMatchFinder* in_finder);
+
+Optimal* ZX7OptimizeFast(unsigned char* in_input_data, size_t in_input_size, int in_max_offset);
+
+#endif
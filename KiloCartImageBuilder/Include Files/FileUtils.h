@@ -14,6 +14,7 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
+#include <stdbool.h>
 #include "CASFile.h"
 
 ///////////////////////////////////////////////////////////////////////////////
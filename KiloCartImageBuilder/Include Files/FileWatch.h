@@ -0,0 +1,45 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Input file watcher and build request pipe of the watch mode               */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __FileWatch_h
+#define __FileWatch_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdbool.h>
+#include <wchar.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define WATCH_MAX_FILE_COUNT 256
+#define WATCH_MAX_DIRECTORY_COUNT 63			// one wait handle is used by the pipe
+#define WATCH_SETTLE_TIME 50							// ms to wait after a change notification (files are written in several steps)
+#define WATCH_PIPE_BUFFER_SIZE 256
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef enum
+{
+	WATCH_FILES_CHANGED,			// content of a watched file has been changed
+	WATCH_BUILD_REQUEST,			// 'build' request is received on the pipe (WatchReply must be called)
+	WATCH_EXIT_REQUEST,				// 'exit' request is received on the pipe (WatchReply must be called)
+	WATCH_ERROR
+} WatchEvent;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool WatchStart(wchar_t** in_file_names, int in_file_count, wchar_t* in_pipe_name);
+WatchEvent WatchWaitForEvent(void);
+bool WatchUpdateFiles(void);
+void WatchReply(const char* in_reply);
+void WatchStop(void);
+
+#endif
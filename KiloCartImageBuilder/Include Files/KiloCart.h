@@ -0,0 +1,155 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Image builder library (in-memory image creation)                          */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __KiloCart_h
+#define __KiloCart_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wchar.h>
+#include "FileUtils.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define CART_ROM_SIZE 65536
+#define CART_PAGE_SIZE 16384
+#define CART_START_ADDRESS 0xc000
+#define ROM_PAGE_CHANGE_ADDRESS 0x3ffc
+#define ROM_PAGE_START_LENGTH 7						// signature and page change code at the start of every page
+#define MAX_FILE_NUMBER 255								// file counts of the directory are stored on a byte
+#define MAX_CARTRIDGE_COUNT 16						// images of the multi-cartridge mode
+#define STREAM_WINDOW_SIZE 128
+
+// ROM file flags (directory entries)
+#define ROM_FILE_FLAG_STREAM 0x01
+#define ROM_FILE_FLAG_XIP 0x02
+#define ROM_FILE_FLAG_VIDEO 0x04
+#define ROM_FILE_FLAG_NATIVE 0x08
+#define ROM_FILE_FLAG_COMPRESSED 0x10
+#define ROM_FILE_FLAG_LZB 0x20
+#define ROM_FILE_FLAG_CODE_FILTER 0x40
+#define ROM_FILE_FLAG_ROW_DELTA 0x80
+#define ROM_FILE_FILTER_MASK (ROM_FILE_FLAG_CODE_FILTER | ROM_FILE_FLAG_ROW_DELTA)
+
+// Option defaults and limits
+#define DEFAULT_PAGE_SLACK 256						// Bytes left free at the end of the pages for the growing files
+#define DEFAULT_FILE_PRIORITY 1						// Priority of the files when no priority is specified
+#define MAX_FILE_PRIORITY 1000000
+
+#define KILOCART_MAX_MESSAGE_LENGTH 512
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Compression levels (all levels create the same stream format)
+typedef enum
+{
+	COMPRESSION_LEVEL_FAST,		// lazy matching with a single hash probe
+	COMPRESSION_LEVEL_OPTIMAL,	// optimal parse (default)
+	COMPRESSION_LEVEL_BEST		// exact optimal parse with the fastest decompression from the equal size parses
+} CompressionLevel;
+
+// Options of the builder
+typedef struct
+{
+	bool ForceCompression;							// every compressible file is stored by ZX7
+	CompressionLevel CompressionLevel;
+	bool AsyncMode;											// background loading
+	bool SegmentedParse;								// large files are parsed in segments in parallel
+	bool CompareExactParse;							// the segmented parse is compared with the exact parse
+	bool Prescreen;											// incompressible files are not compressed
+	int ThreadCount;
+	int OffsetBits;											// extra bits of the long ZX7 offsets
+	bool SearchOffsetBits;							// the offset width is selected by the file content
+	int DecodeBudget;										// allowed decompression time increase of the searched width (percent, -1: no limit)
+	bool StableLayout;									// files are kept at their address in the previous image
+	int PageSlack;
+	bool FitMode;												// the files with the lowest priority are dropped if the files don't fit
+	bool CacheCompressedFiles;					// compressed content is kept for the next builds (unchanged files are not compressed again)
+	bool PrintStats;										// compression statistics are displayed
+	bool Verbose;												// messages are displayed on the standard output and error
+} KiloCartOptions;
+
+// Options of an input file
+typedef struct
+{
+	bool Version2xFile;									// file of the 2.x ROM version directory
+	bool StreamFile;
+	bool XIPFile;
+	bool VideoFile;
+	bool NativeFile;										// native machine code autostart file
+	int LoadAddress;										// RAM address of the native file
+	int EntryAddress;										// Start address of the native file
+	int FilterOptions;									// Filters tried before compression (ROM_FILE_FLAG_CODE_FILTER, ROM_FILE_FLAG_ROW_DELTA)
+	int Group;													// Files of the same group are stored on the same cartridge (-1 if the file is not in a group)
+	int Priority;												// Value of the file in fit mode
+} KiloCartFileOptions;
+
+// Directory entry of a ROM image
+typedef struct
+{
+	char Filename[MAX_TVC_FILE_NAME_LENGTH + 1];	// TVC character set, zero terminated
+	int Address;
+	int Length;
+	int Flags;													// ROM_FILE_FLAG_xxx
+	int LoadAddress;
+	int EntryAddress;
+	bool Version2xFile;									// entry of the 2.x directory (the directories are the same if there are no 2.x files)
+} KiloCartDirectoryEntry;
+
+// Statistics of the last build
+typedef struct
+{
+	int InputFileCount;
+	int InputLength;
+	int FileCount;											// Files of the last created image
+	int UsedBytes;											// Bytes used by the loader, directory and files of the last created image
+	bool CompressedMode;								// at least one file is stored compressed
+	bool Overflow;											// The files didn't fit into the cartridge
+	int OffsetBits;											// Long offset width of the ZX7 content
+	long long LoadTime;									// Estimated load time of the files of the last created image (T-states)
+	int LayoutPassCount;								// Number of the layouts created by the storage mode planning
+	int CartridgeCount;
+	int DroppedFileCount;								// Files left out in fit mode
+} KiloCartStatistics;
+
+// Builder context, all state of the image building is stored in it (builders can be used concurrently)
+typedef struct KiloCartBuilderType KiloCartBuilder;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+void KiloCartGetDefaultOptions(KiloCartOptions* out_options);
+void KiloCartGetDefaultFileOptions(KiloCartFileOptions* out_options);
+
+KiloCartBuilder* KiloCartCreate(KiloCartOptions* in_options);
+void KiloCartRelease(KiloCartBuilder* in_builder);
+void KiloCartSetOptions(KiloCartBuilder* inout_builder, KiloCartOptions* in_options);
+
+bool KiloCartAddFile(KiloCartBuilder* inout_builder, wchar_t* in_file_name, uint8_t* in_data, int in_length, KiloCartFileOptions* in_options);
+bool KiloCartAddCASFile(KiloCartBuilder* inout_builder, wchar_t* in_file_name, uint8_t* in_cas_data, int in_cas_length, KiloCartFileOptions* in_options);
+void KiloCartClearFiles(KiloCartBuilder* inout_builder);
+bool KiloCartSetPreviousImage(KiloCartBuilder* inout_builder, uint8_t* in_image);
+
+bool KiloCartCompressFiles(KiloCartBuilder* inout_builder);
+bool KiloCartBuildImage(KiloCartBuilder* inout_builder, uint8_t* out_image);
+bool KiloCartBuildMultiCartridgeImages(KiloCartBuilder* inout_builder, uint8_t* out_images, int* out_cartridge_count);
+
+int KiloCartGetDirectory(uint8_t* in_image, KiloCartDirectoryEntry* out_entries, int in_max_entry_count);
+void KiloCartGetStatistics(KiloCartBuilder* in_builder, KiloCartStatistics* out_statistics);
+void KiloCartPrintCatalog(KiloCartBuilder* in_builder, FILE* in_file, wchar_t (*in_image_file_names)[MAX_PATH_LENGTH]);
+const wchar_t* KiloCartGetLastError(KiloCartBuilder* in_builder);
+
+uint32_t KiloCartCalculateCRC32(uint8_t* in_data, int in_length);
+
+#endif
@@ -0,0 +1,39 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Byte-aligned LZ compressor (fast decompression by LDIR)                   */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __LZBCompress_h
+#define __LZBCompress_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+
+// Control byte: 0nnnnnnn - n+1 literals, 10nnnnnn o - n+3 bytes from offset o+1,
+// 11nnnnnn ol oh - n+4 bytes from offset oh:ol (offset 0 is the end marker)
+#define LZB_MAX_LITERAL_RUN 128
+#define LZB_MIN_SHORT_MATCH 3
+#define LZB_MAX_SHORT_MATCH 66
+#define LZB_MAX_SHORT_OFFSET 256
+#define LZB_MIN_LONG_MATCH 4
+#define LZB_MAX_LONG_MATCH 67
+#define LZB_SHORT_MATCH_TOKEN 0x80
+#define LZB_LONG_MATCH_TOKEN 0xc0
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+uint8_t* LZBCompress(uint8_t* in_input_data, size_t in_input_size, int in_max_offset, bool in_fast_parse, size_t* out_output_size);
+
+#endif
@@ -0,0 +1,32 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Load time estimation of the loader copy routines                          */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __LoadTime_h
+#define __LoadTime_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define Z80_CLOCK_FREQUENCY 3125000		// TVC CPU clock (Hz)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+long long EstimateRawCopyTime(int in_rom_address, int in_length);
+long long EstimateDecompressionTime(uint8_t* in_compressed_data, int in_compressed_length, int in_rom_address, int in_offset_bits);
+long long EstimateLZBDecompressionTime(uint8_t* in_compressed_data, int in_compressed_length, int in_rom_address);
+long long EstimateCodeFilterTime(uint8_t* in_data, int in_length);
+long long EstimateRowDeltaTime(int in_length);
+int TStatesToMilliseconds(long long in_t_states);
+
+#endif
@@ -0,0 +1,58 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Tape recording (WAV) decoder                                              */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __TapeWave_h
+#define __TapeWave_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdbool.h>
+#include <stdint.h>
+#include "FileUtils.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+
+// Frequencies of the tape signal (one period per bit)
+#define TAPE_FREQ_LEADING 2128					// leading tone before the blocks
+#define TAPE_FREQ_SYNC 1359							// one period between the leading tone and the data
+#define TAPE_FREQ_BIT0 1812
+#define TAPE_FREQ_BIT1 2577
+
+// Tape block header
+#define TAPE_BLOCK_MAGIC 0x6a
+#define TAPE_BLOCK_TYPE_HEADER 0xff
+#define TAPE_BLOCK_TYPE_DATA 0x00
+#define TAPE_SECTOR_LENGTH 256
+#define TAPE_SECTOR_EOF 0xff
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+#pragma pack(push, 1)
+
+// Block header (after the sync period)
+typedef struct
+{
+	uint8_t Zero;
+	uint8_t Magic;						// TAPE_BLOCK_MAGIC
+	uint8_t BlockType;				// TAPE_BLOCK_TYPE_xxx
+	uint8_t FileType;					// Buffered: 0x01, non-buffered: 0x11
+	uint8_t CopyProtect;
+	uint8_t SectorCount;			// 0 means 256
+} TapeBlockHeaderType;
+
+#pragma pack(pop)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool TapeDecodeWaveFile(wchar_t* in_wave_file_name, wchar_t* in_cas_directory, int in_max_file_count, wchar_t (*out_file_names)[MAX_PATH_LENGTH], int* out_file_count);
+
+#endif
@@ -0,0 +1,27 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Video memory filter (XOR delta of the screen rows)                        */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __VideoFilter_h
+#define __VideoFilter_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define VIDEO_ROW_LENGTH 64		// bytes of a pixel row in the video memory (in every graphics mode)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+uint8_t* EncodeVideoRowDelta(uint8_t* in_data, int in_length);
+
+#endif
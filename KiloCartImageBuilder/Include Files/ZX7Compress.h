@@ -26,22 +26,66 @@
 #ifndef __ZX7Compress_h
 #define __ZX7Compress_h
 
-#define MAX_OFFSET  2176  /* range 1..2176 */
+#define MAX_OFFSET  2176  /* range 1..2176 (MAX_OFFSET_OF(OFFSET_BITS)) */
 #define MAX_LEN    65536  /* range 2..65536 */
 
-typedef struct match_t {
-    size_t index;
-    struct match_t *next;
-} Match;
+#define MAX_INPUT_SIZE 65536  /* positions are stored on 16 bits */
 
+/* long offsets (129..) are stored on a byte and offset_bits extra bits, the
+   original format has 4 extra bits (the decompressor's bit marker is patched
+   for the other widths) */
+#define OFFSET_BITS      4
+#define MIN_OFFSET_BITS  1
+#define MAX_OFFSET_BITS  7
+#define MAX_OFFSET_OF(offset_bits) (128*((1 << (offset_bits))+1))
+
+#define RANGE_HISTORY_BITS 0x10000000  /* cost of the history positions of a range parse */
+
+/* optimal parse (structure of arrays): bits is the cost of the input up to
+   the position, offset and len are the sequence ending at the position
+   (len is 0 for literal) */
 typedef struct optimal_t {
-    size_t bits;
-    int offset;
-    int len;
+    size_t size;
+    unsigned int *bits;
+    unsigned short *offset;
+    unsigned short *len;
 } Optimal;
 
-Optimal *ZX7Optimize(unsigned char *input_data, size_t input_size);
+/* match candidates of the [start, end) range: candidates of position i are
+   first[i-start]..first[i-start+1]-1, a candidate covers the lengths from the
+   previous candidate's len+1 (or 2) to its len */
+typedef struct match_table_t {
+    size_t start;
+    size_t end;
+    unsigned int *first;
+    unsigned short *offset;
+    unsigned short *len;
+    size_t count;
+    size_t capacity;
+    size_t chain_steps;      /* match chain links walked */
+    size_t extension_steps;  /* positions compared in the length extension loop */
+} MatchTable;
+
+int offset_bits_of(int max_offset);
+
+int count_bits(int offset, int len, int offset_bits);
+
+Optimal *ZX7Optimize(unsigned char *input_data, size_t input_size, int max_offset);
+
+Optimal *ZX7OptimizeRange(unsigned char *input_data, size_t input_size, int max_offset, size_t start, size_t end);
+
+Optimal *ZX7AllocateOptimal(size_t input_size);
+
+void ZX7FreeOptimal(Optimal *optimal);
+
+MatchTable *ZX7FindMatches(unsigned char *input_data, size_t input_size, int max_offset, size_t start, size_t end);
+
+Optimal *ZX7OptimizeMatches(MatchTable *table, size_t input_size, int max_offset);
+
+Optimal *ZX7OptimizeMatchesLongest(MatchTable *table, size_t input_size, int max_offset);
+
+void ZX7FreeMatchTable(MatchTable *table);
 
-unsigned char *ZX7Compress(Optimal *optimal, unsigned char *input_data, size_t input_size, size_t *output_size);
+unsigned char *ZX7Compress(Optimal *optimal, unsigned char *input_data, size_t input_size, int max_offset, size_t *output_size);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Parallel match finding for the ZX7 compressor                             */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __ZX7Parallel_h
+#define __ZX7Parallel_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include "ZX7Compress.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define ZX7_MIN_CHUNK_LENGTH 4096	// Inputs shorter than two chunks are processed on the calling thread
+#define ZX7_MAX_CHUNK_COUNT 16
+#define ZX7_MAX_THREAD_COUNT 16
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef void (*ZX7ParallelTask)(void* inout_context);
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+Optimal* ZX7OptimizeParallel(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, int in_thread_count);
+MatchTable* ZX7FindMatchesParallel(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, int in_thread_count);
+void ZX7RunParallel(ZX7ParallelTask in_task, void* inout_contexts, size_t in_context_size, int in_count);
+int ZX7GetProcessorCount(void);
+
+#endif
@@ -0,0 +1,29 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Parallel segmented optimal parse for the ZX7 compressor                   */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __ZX7Segmented_h
+#define __ZX7Segmented_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include "ZX7Compress.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define ZX7_MIN_SEGMENT_LENGTH 8192	// Files shorter than two segments are parsed in one piece
+#define ZX7_MAX_SEGMENT_COUNT 16
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+Optimal* ZX7OptimizeSegmented(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, int in_thread_count, int* out_segment_count);
+
+#endif
@@ -0,0 +1,63 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Bit accounting and match finder statistics of the ZX7 compressed data     */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+#ifndef __ZX7Stats_h
+#define __ZX7Stats_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdbool.h>
+#include <stddef.h>
+#include "ZX7Compress.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define ZX7_STATS_REGION_SIZE 256																		// input bytes of a heat map region
+#define ZX7_STATS_MAX_REGION_COUNT (MAX_INPUT_SIZE / ZX7_STATS_REGION_SIZE)
+#define ZX7_STATS_LENGTH_CLASS_COUNT 16		// class k: length - 1 is 2^k..2^(k+1)-1 (Elias-gamma code of 2k+1 bits)
+#define ZX7_STATS_OFFSET_CLASS_COUNT 15		// class k: offset is 2^k..2^(k+1)-1
+#define ZX7_END_MARKER_BITS 18						// sequence indicator and Elias-gamma code of the end marker
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	size_t InputLength;
+	size_t CompressedLength;
+
+	// bit accounting of the compressed stream
+	size_t LiteralCount;
+	size_t SequenceCount;
+	size_t LiteralBits;						// literal bytes (the first byte included)
+	size_t FlagBits;							// literal/sequence indicators
+	size_t LengthBits;						// Elias-gamma coded sequence lengths
+	size_t ShortOffsetCount;			// offsets 1..128 (one byte)
+	size_t ShortOffsetBits;
+	size_t LongOffsetCount;				// offsets from 129 (one byte and the extra bits of the format)
+	size_t LongOffsetBits;
+	size_t LengthHistogram[ZX7_STATS_LENGTH_CLASS_COUNT];
+	size_t OffsetHistogram[ZX7_STATS_OFFSET_CLASS_COUNT];
+
+	// match finder work
+	size_t ChainSteps;						// match chain links walked
+	size_t ExtensionSteps;				// positions compared in the length extension loop
+
+	// heat map: compressed bits of every ZX7_STATS_REGION_SIZE input bytes
+	int RegionCount;
+	unsigned int RegionBits[ZX7_STATS_MAX_REGION_COUNT];
+} ZX7Stats;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool ZX7CollectStats(unsigned char* in_compressed_data, size_t in_compressed_size, int in_offset_bits, ZX7Stats* out_stats);
+bool ZX7CollectMatchFinderStats(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, ZX7Stats* inout_stats);
+
+#endif
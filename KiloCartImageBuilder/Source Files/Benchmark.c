@@ -0,0 +1,431 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Builder benchmark (synthetic CAS files, phase time and memory usage)      */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Windows.h>
+#include <Psapi.h>
+#include "CASFile.h"
+#include "FileUtils.h"
+#include "Benchmark.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define CODE_LOAD_ADDRESS 0x1a00				// start of the BASIC program area
+#define CODE_REPEAT_PERCENT 20					// probability of the repeated instruction sequences
+#define SCREEN_ROW_LENGTH 64
+#define SCREEN_PALETTE_LENGTH 4
+#define SCREEN_COPY_ROW_PERCENT 75			// probability of the rows which are similar to the previous row
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	const wchar_t* Name;
+	double Time;						// ms
+	size_t StartMemory;			// committed memory of the process (bytes)
+	size_t PeakMemory;
+	size_t EndMemory;
+} BenchmarkPhase;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static uint32_t NextRandom(void);
+static int RandomRange(int in_range);
+static void GenerateCode(uint8_t* out_data, int in_length);
+static void GenerateScreen(uint8_t* out_data, int in_length);
+static void GenerateRandom(uint8_t* out_data, int in_length);
+static bool WriteCASFile(wchar_t* in_file_name, uint8_t* in_data, int in_length);
+static size_t GetCommittedMemory(void);
+static DWORD WINAPI MemorySamplerThread(LPVOID in_param);
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables
+static uint32_t g_random_state;
+
+static bool g_benchmark_enabled = false;
+static BenchmarkPhase g_phases[BENCHMARK_MAX_PHASE_COUNT];
+static int g_phase_count = 0;
+static LARGE_INTEGER g_phase_start_time;
+static HANDLE g_sampler_thread = NULL;
+static volatile bool g_sampler_running = false;
+static volatile size_t g_sampled_peak_memory;
+
+// frequent one byte instructions (LD r,r', INC/DEC, PUSH/POP, RET, ...)
+static const uint8_t l_code_opcodes[] = { 0x7e, 0x77, 0x23, 0x2b, 0x13, 0x1b, 0xc9, 0xe5, 0xe1, 0xd5, 0xd1, 0xc5, 0xc1, 0xf5,
+	0xf1, 0x3c, 0x3d, 0x04, 0x05, 0xaf, 0xb7, 0x47, 0x4f, 0x57, 0x5f, 0x78, 0x79, 0x7a, 0x7b, 0xeb, 0x09, 0x19, 0x1a, 0x12 };
+
+// instructions with byte operand (LD r,n, JR, DJNZ, CP n, AND n, OUT, IN)
+static const uint8_t l_code_byte_operand_opcodes[] = { 0x3e, 0x06, 0x0e, 0x16, 0x1e, 0x18, 0x20, 0x28, 0x30, 0x38, 0xfe, 0xe6,
+	0x10, 0xd3, 0xdb };
+
+// instructions with address operand (CALL, JP, LD rr,nn, LD A,(nn), LD (nn),A, ...)
+static const uint8_t l_code_word_operand_opcodes[] = { 0xcd, 0xcd, 0xcd, 0xc3, 0x21, 0x11, 0x01, 0x3a, 0x32, 0xca, 0xc2, 0x2a,
+	0x22 };
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the synthetic CAS files in the given directory. The length of the files
+// varies from the half to one and a half times of the given length, the payload
+// types (BENCHMARK_PAYLOAD_xxx characters) are used in turn. The content depends
+// only on the parameters, so the runs are repeatable.
+bool BenchmarkCreateFiles(wchar_t* in_directory, int in_file_count, int in_file_length, wchar_t* in_payloads, wchar_t (*out_file_names)[MAX_PATH_LENGTH])
+{
+	uint8_t* data;
+	int length;
+	int payload_count;
+	bool success = true;
+	int i;
+
+	if (!CreateDirectoryW(in_directory, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		fwprintf(stderr, L"\nCan't create directory: %s", in_directory);
+		return false;
+	}
+
+	data = (uint8_t*)malloc(BENCHMARK_MAX_FILE_LENGTH);
+	if (data == NULL)
+	{
+		fprintf(stderr, "Error: Insufficient memory\n");
+		exit(1);
+	}
+
+	payload_count = (int)wcslen(in_payloads);
+
+	for (i = 0; i < in_file_count && success; i++)
+	{
+		g_random_state = 0x9e3779b9u ^ ((uint32_t)(i + 1) * 2654435761u);
+
+		length = in_file_length / 2 + RandomRange(in_file_length + 1);
+		if (length < 1)
+			length = 1;
+		if (length > BENCHMARK_MAX_FILE_LENGTH)
+			length = BENCHMARK_MAX_FILE_LENGTH;
+
+		switch (in_payloads[i % payload_count])
+		{
+			case BENCHMARK_PAYLOAD_CODE:
+				GenerateCode(data, length);
+				break;
+
+			case BENCHMARK_PAYLOAD_SCREEN:
+				GenerateScreen(data, length);
+				break;
+
+			default:
+				GenerateRandom(data, length);
+				break;
+		}
+
+		swprintf_s(out_file_names[i], MAX_PATH_LENGTH, L"%sBENCH%03d.CAS", in_directory, i);
+		success = WriteCASFile(out_file_names[i], data, length);
+	}
+
+	free(data);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Deletes the synthetic files and their directory
+void BenchmarkDeleteFiles(wchar_t* in_directory, wchar_t (*in_file_names)[MAX_PATH_LENGTH], int in_file_count)
+{
+	int i;
+
+	for (i = 0; i < in_file_count; i++)
+		DeleteFileW(in_file_names[i]);
+
+	RemoveDirectoryW(in_directory);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Enables the phase measurement (phase functions do nothing until it is called)
+void BenchmarkStart(void)
+{
+	g_benchmark_enabled = true;
+	g_phase_count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Starts the measurement of a build phase
+void BenchmarkPhaseStart(const wchar_t* in_name)
+{
+	BenchmarkPhase* phase;
+
+	if (!g_benchmark_enabled || g_phase_count >= BENCHMARK_MAX_PHASE_COUNT || g_sampler_thread != NULL)
+		return;
+
+	phase = &g_phases[g_phase_count];
+	phase->Name = in_name;
+	phase->StartMemory = GetCommittedMemory();
+
+	// the peak of the phase is sampled by a background thread
+	g_sampled_peak_memory = phase->StartMemory;
+	g_sampler_running = true;
+	g_sampler_thread = CreateThread(NULL, 0, MemorySamplerThread, NULL, 0, NULL);
+
+	QueryPerformanceCounter(&g_phase_start_time);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finishes the measurement of the current build phase
+void BenchmarkPhaseEnd(void)
+{
+	LARGE_INTEGER end_time;
+	LARGE_INTEGER frequency;
+	BenchmarkPhase* phase;
+
+	if (!g_benchmark_enabled || g_sampler_thread == NULL)
+		return;
+
+	QueryPerformanceCounter(&end_time);
+	QueryPerformanceFrequency(&frequency);
+
+	g_sampler_running = false;
+	WaitForSingleObject(g_sampler_thread, INFINITE);
+	CloseHandle(g_sampler_thread);
+	g_sampler_thread = NULL;
+
+	phase = &g_phases[g_phase_count++];
+	phase->Time = (double)(end_time.QuadPart - g_phase_start_time.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+	phase->EndMemory = GetCommittedMemory();
+	phase->PeakMemory = (g_sampled_peak_memory > phase->EndMemory) ? g_sampled_peak_memory : phase->EndMemory;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays the time and the memory usage of the measured phases
+void BenchmarkPrintReport(void)
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	double total_time = 0;
+	int i;
+
+	fwprintf(stdout, L"\n\nBenchmark results:");
+	fwprintf(stdout, L"\n  Phase        Time (ms)  Start (KB)   Peak (KB)    End (KB)");
+
+	for (i = 0; i < g_phase_count; i++)
+	{
+		fwprintf(stdout, L"\n  %-10s %11.1f %11d %11d %11d", g_phases[i].Name, g_phases[i].Time,
+			(int)(g_phases[i].StartMemory / 1024), (int)(g_phases[i].PeakMemory / 1024), (int)(g_phases[i].EndMemory / 1024));
+
+		total_time += g_phases[i].Time;
+	}
+
+	fwprintf(stdout, L"\n  %-10s %11.1f", L"total", total_time);
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		fwprintf(stdout, L"\n  Peak committed memory of the process: %d KB", (int)(counters.PeakPagefileUsage / 1024));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Xorshift pseudo random number generator
+static uint32_t NextRandom(void)
+{
+	g_random_state ^= g_random_state << 13;
+	g_random_state ^= g_random_state >> 17;
+	g_random_state ^= g_random_state << 5;
+
+	return g_random_state;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Random number in the 0..in_range-1 range
+static int RandomRange(int in_range)
+{
+	return (int)(NextRandom() % (uint32_t)in_range);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Generates Z80 machine code like content: frequent one byte instructions, byte
+// operands, absolute addresses inside the program and repeated instruction
+// sequences (common idioms of the compiled and hand written code)
+static void GenerateCode(uint8_t* out_data, int in_length)
+{
+	uint16_t address;
+	int sequence_start;
+	int sequence_length;
+	int pos = 0;
+	int kind;
+
+	while (pos < in_length)
+	{
+		// repeat an earlier sequence
+		if (pos > 32 && RandomRange(100) < CODE_REPEAT_PERCENT)
+		{
+			sequence_length = 4 + RandomRange(20);
+			sequence_start = RandomRange(pos - sequence_length);
+
+			while (sequence_length > 0 && pos < in_length)
+			{
+				out_data[pos++] = out_data[sequence_start++];
+				sequence_length--;
+			}
+
+			continue;
+		}
+
+		kind = RandomRange(100);
+		if (kind < 60)
+		{
+			out_data[pos++] = l_code_opcodes[RandomRange(sizeof(l_code_opcodes))];
+		}
+		else if (kind < 80)
+		{
+			out_data[pos++] = l_code_byte_operand_opcodes[RandomRange(sizeof(l_code_byte_operand_opcodes))];
+			if (pos < in_length)
+				out_data[pos++] = (uint8_t)RandomRange(32);
+		}
+		else
+		{
+			address = (uint16_t)(CODE_LOAD_ADDRESS + RandomRange(in_length));
+
+			out_data[pos++] = l_code_word_operand_opcodes[RandomRange(sizeof(l_code_word_operand_opcodes))];
+			if (pos < in_length)
+				out_data[pos++] = (uint8_t)address;
+			if (pos < in_length)
+				out_data[pos++] = (uint8_t)(address >> 8);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Generates bitmap like content in the video memory layout: runs of a few colour
+// bytes, most of the rows are slightly changed copies of the previous row
+static void GenerateScreen(uint8_t* out_data, int in_length)
+{
+	uint8_t palette[SCREEN_PALETTE_LENGTH];
+	uint8_t colour;
+	int row_end;
+	int run_length;
+	int change_count;
+	int pos = 0;
+	int i;
+
+	palette[0] = 0x00;
+	for (i = 1; i < SCREEN_PALETTE_LENGTH; i++)
+		palette[i] = (uint8_t)NextRandom();
+
+	while (pos < in_length)
+	{
+		row_end = (pos + SCREEN_ROW_LENGTH < in_length) ? pos + SCREEN_ROW_LENGTH : in_length;
+
+		if (pos >= SCREEN_ROW_LENGTH && RandomRange(100) < SCREEN_COPY_ROW_PERCENT)
+		{
+			// similar to the previous row
+			memcpy(out_data + pos, out_data + pos - SCREEN_ROW_LENGTH, row_end - pos);
+
+			change_count = RandomRange(4);
+			for (i = 0; i < change_count; i++)
+				out_data[pos + RandomRange(row_end - pos)] = palette[RandomRange(SCREEN_PALETTE_LENGTH)];
+
+			pos = row_end;
+		}
+		else
+		{
+			// new row of colour runs
+			while (pos < row_end)
+			{
+				colour = palette[RandomRange(SCREEN_PALETTE_LENGTH)];
+				run_length = 1 + RandomRange(16);
+
+				while (run_length > 0 && pos < row_end)
+				{
+					out_data[pos++] = colour;
+					run_length--;
+				}
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Generates incompressible content
+static void GenerateRandom(uint8_t* out_data, int in_length)
+{
+	int i;
+
+	for (i = 0; i < in_length; i++)
+		out_data[i] = (uint8_t)(NextRandom() >> 24);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes the data as a non-buffered CAS program file
+static bool WriteCASFile(wchar_t* in_file_name, uint8_t* in_data, int in_length)
+{
+	FILE* cas_file = NULL;
+	CASUPMHeaderType upm_header;
+	CASProgramFileHeaderType program_header;
+	int file_length;
+	bool success = true;
+
+	if (_wfopen_s(&cas_file, in_file_name, L"wb") != 0 || cas_file == NULL)
+	{
+		fwprintf(stderr, L"\nCan't create file: %s", in_file_name);
+		return false;
+	}
+
+	file_length = sizeof(upm_header) + sizeof(program_header) + in_length;
+
+	memset(&upm_header, 0, sizeof(upm_header));
+	upm_header.FileType = CASBLOCKHDR_FILE_UNBUFFERED;
+	upm_header.BlockNumber = (uint16_t)(file_length / CAS_BLOCK_LENGTH);
+	upm_header.LastBlockBytes = (uint8_t)(file_length % CAS_BLOCK_LENGTH);
+
+	memset(&program_header, 0, sizeof(program_header));
+	program_header.FileType = UPMPROGTYPE_PRG;
+	program_header.FileLength = (uint16_t)in_length;
+	program_header.Autorun = 0xff;
+
+	WriteBlock(cas_file, &upm_header, sizeof(upm_header), &success);
+	WriteBlock(cas_file, &program_header, sizeof(program_header), &success);
+	WriteBlock(cas_file, in_data, in_length, &success);
+
+	fclose(cas_file);
+
+	if (!success)
+		fwprintf(stderr, L"\nFile write error: %s", in_file_name);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the committed (private) memory of the process
+static size_t GetCommittedMemory(void)
+{
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.PagefileUsage;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Samples the committed memory while the phase is running
+static DWORD WINAPI MemorySamplerThread(LPVOID in_param)
+{
+	size_t memory;
+
+	(void)in_param;
+
+	while (g_sampler_running)
+	{
+		memory = GetCommittedMemory();
+		if (memory > g_sampled_peak_memory)
+			g_sampled_peak_memory = memory;
+
+		Sleep(BENCHMARK_SAMPLE_INTERVAL);
+	}
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Z80 machine code filter (position relative CALL/JP/LD HL operands)      */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CodeFilter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the filtered copy of the data. The operands of CALL nn, CALL cc,nn,
+// JP nn, JP cc,nn and LD HL,nn are replaced by the operand minus its offset in
+// the file. Operand bytes are skipped, so the loader (DECODE_FILTER) finds the
+// same instructions in the restored data. Returns NULL if there is not enough memory.
+uint8_t* EncodeCodeFilter(uint8_t* in_data, int in_length)
+{
+	uint8_t* filtered_data;
+	uint16_t operand;
+	int i;
+
+	filtered_data = (uint8_t*)malloc(in_length);
+	if (filtered_data == NULL)
+		return NULL;
+
+	memcpy(filtered_data, in_data, in_length);
+
+	i = 0;
+	while (i + CODE_FILTER_INSTRUCTION_LENGTH <= in_length)
+	{
+		if (IsCodeFilterOpcode(in_data[i]))
+		{
+			operand = (uint16_t)(in_data[i + 1] | (in_data[i + 2] << 8));
+			operand = (uint16_t)(operand - (i + 1));
+			filtered_data[i + 1] = (uint8_t)operand;
+			filtered_data[i + 2] = (uint8_t)(operand >> 8);
+
+			i += CODE_FILTER_INSTRUCTION_LENGTH;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	return filtered_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true if the opcode has an absolute address operand which is filtered
+bool IsCodeFilterOpcode(uint8_t in_opcode)
+{
+	return in_opcode == 0xcd ||							// CALL nn
+		in_opcode == 0xc3 ||									// JP nn
+		in_opcode == 0x21 ||									// LD HL,nn
+		(in_opcode & 0xc7) == 0xc2 ||					// JP cc,nn
+		(in_opcode & 0xc7) == 0xc4;						// CALL cc,nn
+}
@@ -0,0 +1,111 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Compressibility estimation (pre-screen of the incompressible files)       */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Compressibility.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define DIGRAM_COUNT 65536
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static double GetCountEntropy(int in_count);
+
+///////////////////////////////////////////////////////////////////////////////
+// Estimates the compressibility of the data from its order-0 and order-1 entropy
+// and from the ratio of the digrams which can be found in the window before them
+// (every match of the compressors starts with such a digram). The file is handled
+// as incompressible when both the byte distribution and the digram hits are close
+// to the random data. Returns false if there is not enough memory.
+bool EstimateCompressibility(uint8_t* in_data, int in_length, int in_window_size, CompressibilityEstimate* out_estimate)
+{
+	int byte_counts[256];
+	int* pair_counts;
+	int* last_positions;
+	int digram;
+	int hit_count = 0;
+	double order0 = 0;
+	double order1 = 0;
+	int i;
+
+	memset(out_estimate, 0, sizeof(CompressibilityEstimate));
+
+	if (in_length < 2)
+		return true;
+
+	pair_counts = (int*)calloc(DIGRAM_COUNT, sizeof(int));
+	last_positions = (int*)malloc(DIGRAM_COUNT * sizeof(int));
+	if (pair_counts == NULL || last_positions == NULL)
+	{
+		free(pair_counts);
+		free(last_positions);
+		return false;
+	}
+
+	for (i = 0; i < DIGRAM_COUNT; i++)
+		last_positions[i] = -in_window_size - 1;
+
+	memset(byte_counts, 0, sizeof(byte_counts));
+	byte_counts[in_data[in_length - 1]]++;
+
+	// byte and digram statistics in one pass
+	for (i = 0; i < in_length - 1; i++)
+	{
+		digram = (in_data[i] << 8) | in_data[i + 1];
+
+		byte_counts[in_data[i]]++;
+		pair_counts[digram]++;
+
+		if (i - last_positions[digram] <= in_window_size)
+			hit_count++;
+
+		last_positions[digram] = i;
+	}
+
+	// order-0 entropy: log2(n) - sum(c * log2(c)) / n
+	for (i = 0; i < 256; i++)
+		order0 -= GetCountEntropy(byte_counts[i]);
+
+	order0 = order0 / in_length + log2(in_length);
+
+	// order-1 entropy: sum over the contexts of (c * log2(c) - sum(p * log2(p))) / (n - 1)
+	for (i = 0; i < DIGRAM_COUNT; i++)
+		order1 -= GetCountEntropy(pair_counts[i]);
+
+	for (i = 0; i < 256; i++)
+		order1 += GetCountEntropy(byte_counts[i] - ((in_data[in_length - 1] == i) ? 1 : 0));
+
+	order1 /= in_length - 1;
+
+	out_estimate->Order0Entropy = (float)order0;
+	out_estimate->Order1Entropy = (float)order1;
+	out_estimate->DigramHitRate = (float)hit_count / (in_length - 1);
+	out_estimate->Incompressible = in_length >= COMPRESSIBILITY_MIN_LENGTH && out_estimate->Order0Entropy >= COMPRESSIBILITY_MIN_ENTROPY &&
+		out_estimate->DigramHitRate <= COMPRESSIBILITY_MAX_DIGRAM_HITS;
+
+	free(pair_counts);
+	free(last_positions);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets c * log2(c) of a symbol count
+static double GetCountEntropy(int in_count)
+{
+	return (in_count > 0) ? in_count * log2(in_count) : 0;
+}
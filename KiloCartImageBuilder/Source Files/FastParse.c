@@ -0,0 +1,160 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Lazy matching parse with a single hash probe (fast compression level)     */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FastParse.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static int GetHash(uint8_t* in_data);
+
+///////////////////////////////////////////////////////////////////////////////
+// Initializes match finder of the input (returns false if there is not enough memory)
+bool FastMatchInit(FastMatchFinder* in_finder, uint8_t* in_input_data, size_t in_input_size, int in_max_offset)
+{
+	in_finder->InputData = in_input_data;
+	in_finder->InputSize = in_input_size;
+	in_finder->MaxOffset = in_max_offset;
+	in_finder->Inserted = 0;
+	in_finder->Heads = (int*)malloc(FAST_MATCH_HASH_SIZE * sizeof(int));
+
+	if (in_finder->Heads == NULL)
+		return false;
+
+	memset(in_finder->Heads, 0xff, FAST_MATCH_HASH_SIZE * sizeof(int));
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds match at the given position by checking only the last preceding position
+// which has the same hash. Positions must be increasing between the
+// calls. Returns the length of the match (0 if there is no match).
+size_t FastMatchFind(FastMatchFinder* in_finder, size_t in_position, size_t in_max_length, int* out_offset)
+{
+	uint8_t* data = in_finder->InputData;
+	size_t length;
+	int previous;
+
+	// add the skipped positions to the hash table
+	for (; in_finder->Inserted < in_position; in_finder->Inserted++)
+	{
+		if (in_finder->Inserted + FAST_MATCH_HASH_LENGTH <= in_finder->InputSize)
+			in_finder->Heads[GetHash(data + in_finder->Inserted)] = (int)in_finder->Inserted;
+	}
+
+	*out_offset = 0;
+
+	if (in_position + FAST_MATCH_HASH_LENGTH > in_finder->InputSize)
+		return 0;
+
+	previous = in_finder->Heads[GetHash(data + in_position)];
+	if (previous < 0 || (int)(in_position - previous) > in_finder->MaxOffset)
+		return 0;
+
+	if (in_max_length > in_finder->InputSize - in_position)
+		in_max_length = in_finder->InputSize - in_position;
+
+	// the match can overlap the current position (it is copied byte by byte)
+	length = 0;
+	while (length < in_max_length && data[previous + length] == data[in_position + length])
+		length++;
+
+	if (length < 2)
+		return 0;
+
+	*out_offset = (int)(in_position - previous);
+
+	return length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases match finder
+void FastMatchFree(FastMatchFinder* in_finder)
+{
+	free(in_finder->Heads);
+	in_finder->Heads = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates ZX7 parse by lazy matching: the match of the position is used unless
+// the next position has a longer one. The result is a valid (but not optimal)
+// parse for ZX7Compress (NULL if there is not enough memory).
+Optimal* ZX7OptimizeFast(unsigned char* in_input_data, size_t in_input_size, int in_max_offset)
+{
+	FastMatchFinder finder;
+	Optimal* optimal;
+	size_t position;
+	size_t end;
+	size_t length;
+	size_t next_length;
+	int offset;
+	int next_offset;
+	int offset_bits = offset_bits_of(in_max_offset);
+
+	optimal = ZX7AllocateOptimal(in_input_size);
+	if (optimal == NULL || in_input_size == 0)
+		return optimal;
+
+	if (!FastMatchInit(&finder, in_input_data, in_input_size, in_max_offset))
+	{
+		ZX7FreeOptimal(optimal);
+		return NULL;
+	}
+
+	// first byte is always literal
+	optimal->bits[0] = 8;
+	position = 1;
+	length = FastMatchFind(&finder, position, MAX_LEN, &offset);
+
+	while (position < in_input_size)
+	{
+		next_length = FastMatchFind(&finder, position + 1, MAX_LEN, &next_offset);
+
+		if (length < 2 || next_length > length)
+		{
+			// literal
+			optimal->bits[position] = optimal->bits[position - 1] + 9;
+			position++;
+
+			length = next_length;
+			offset = next_offset;
+		}
+		else
+		{
+			// sequence (bits, offset and len are stored at its last byte)
+			end = position + length - 1;
+			optimal->bits[end] = optimal->bits[position - 1] + count_bits(offset, (int)length, offset_bits);
+			optimal->offset[end] = (unsigned short)offset;
+			optimal->len[end] = (unsigned short)length;
+			position += length;
+
+			length = FastMatchFind(&finder, position, MAX_LEN, &offset);
+		}
+	}
+
+	FastMatchFree(&finder);
+
+	return optimal;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates hash of the bytes at the position
+static int GetHash(uint8_t* in_data)
+{
+	uint32_t value = (uint32_t)in_data[0] << 16 | (uint32_t)in_data[1] << 8 | in_data[2];
+
+	return (int)((value * 2654435761u) >> (32 - FAST_MATCH_HASH_BITS));
+}
@@ -0,0 +1,331 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Input file watcher and build request pipe of the watch mode               */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Windows.h>
+#include "FileWatch.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	wchar_t* FileName;
+	FILETIME LastWriteTime;
+	DWORD FileSize;
+} WatchedFileInfo;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static bool AddWatchedDirectory(wchar_t* in_file_name);
+static void GetWatchedFileState(WatchedFileInfo* inout_file_info, FILETIME* out_last_write_time, DWORD* out_file_size);
+static bool ConnectPipeClient(void);
+static bool ReadPipeRequest(char* out_request, int in_buffer_length);
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables
+static WatchedFileInfo g_watched_files[WATCH_MAX_FILE_COUNT];
+static int g_watched_file_count = 0;
+
+static wchar_t g_watched_directories[WATCH_MAX_DIRECTORY_COUNT][MAX_PATH];
+static HANDLE g_directory_handles[WATCH_MAX_DIRECTORY_COUNT];
+static int g_watched_directory_count = 0;
+
+static HANDLE g_pipe = INVALID_HANDLE_VALUE;
+static OVERLAPPED g_pipe_overlapped;
+
+///////////////////////////////////////////////////////////////////////////////
+// Starts watching the directories of the given files and creates the build request
+// pipe ('\\.\pipe\<name>', no pipe is created if the name is empty)
+bool WatchStart(wchar_t** in_file_names, int in_file_count, wchar_t* in_pipe_name)
+{
+	wchar_t pipe_path[MAX_PATH];
+	int i;
+
+	if (in_file_count > WATCH_MAX_FILE_COUNT)
+		in_file_count = WATCH_MAX_FILE_COUNT;
+
+	for (i = 0; i < in_file_count; i++)
+	{
+		if (!AddWatchedDirectory(in_file_names[i]))
+			return false;
+
+		g_watched_files[i].FileName = in_file_names[i];
+		GetWatchedFileState(&g_watched_files[i], &g_watched_files[i].LastWriteTime, &g_watched_files[i].FileSize);
+	}
+	g_watched_file_count = in_file_count;
+
+	// build request pipe
+	if (in_pipe_name != NULL && in_pipe_name[0] != '\0')
+	{
+		swprintf_s(pipe_path, MAX_PATH, L"\\\\.\\pipe\\%s", in_pipe_name);
+
+		g_pipe = CreateNamedPipeW(pipe_path, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+			1, WATCH_PIPE_BUFFER_SIZE, WATCH_PIPE_BUFFER_SIZE, 0, NULL);
+		if (g_pipe == INVALID_HANDLE_VALUE)
+		{
+			fwprintf(stderr, L"\nCan't create pipe: %s", pipe_path);
+			return false;
+		}
+
+		memset(&g_pipe_overlapped, 0, sizeof(g_pipe_overlapped));
+		g_pipe_overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+		if (g_pipe_overlapped.hEvent == NULL)
+			return false;
+
+		if (!ConnectPipeClient())
+			return false;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Waits until a watched file is changed or a request is received on the pipe
+WatchEvent WatchWaitForEvent(void)
+{
+	HANDLE handles[WATCH_MAX_DIRECTORY_COUNT + 1];
+	char request[WATCH_PIPE_BUFFER_SIZE];
+	DWORD handle_count;
+	DWORD result;
+
+	memcpy(handles, g_directory_handles, sizeof(HANDLE) * g_watched_directory_count);
+	handle_count = g_watched_directory_count;
+
+	if (g_pipe != INVALID_HANDLE_VALUE)
+		handles[handle_count++] = g_pipe_overlapped.hEvent;
+
+	while (true)
+	{
+		result = WaitForMultipleObjects(handle_count, handles, FALSE, INFINITE);
+		if (result < WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + handle_count)
+			return WATCH_ERROR;
+
+		result -= WAIT_OBJECT_0;
+		if (result < (DWORD)g_watched_directory_count)
+		{
+			// directory is changed, notifications of other files of the directory are ignored
+			if (!FindNextChangeNotification(g_directory_handles[result]))
+				return WATCH_ERROR;
+
+			Sleep(WATCH_SETTLE_TIME);
+
+			if (WatchUpdateFiles())
+				return WATCH_FILES_CHANGED;
+		}
+		else
+		{
+			// client is connected to the pipe
+			if (!ReadPipeRequest(request, WATCH_PIPE_BUFFER_SIZE))
+			{
+				DisconnectNamedPipe(g_pipe);
+				if (!ConnectPipeClient())
+					return WATCH_ERROR;
+
+				continue;
+			}
+
+			if (strcmp(request, "build") == 0)
+				return WATCH_BUILD_REQUEST;
+
+			if (strcmp(request, "exit") == 0)
+				return WATCH_EXIT_REQUEST;
+
+			WatchReply("error unknown request\n");
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Updates the stored state of the watched files, returns true if any of them
+// has been changed since the last update
+bool WatchUpdateFiles(void)
+{
+	FILETIME last_write_time;
+	DWORD file_size;
+	bool changed = false;
+	int i;
+
+	for (i = 0; i < g_watched_file_count; i++)
+	{
+		GetWatchedFileState(&g_watched_files[i], &last_write_time, &file_size);
+
+		if (CompareFileTime(&last_write_time, &g_watched_files[i].LastWriteTime) != 0 || file_size != g_watched_files[i].FileSize)
+		{
+			g_watched_files[i].LastWriteTime = last_write_time;
+			g_watched_files[i].FileSize = file_size;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sends the reply to the request and waits for the next client
+void WatchReply(const char* in_reply)
+{
+	DWORD written;
+
+	if (g_pipe == INVALID_HANDLE_VALUE)
+		return;
+
+	if (!WriteFile(g_pipe, in_reply, (DWORD)strlen(in_reply), &written, &g_pipe_overlapped))
+	{
+		if (GetLastError() == ERROR_IO_PENDING)
+			GetOverlappedResult(g_pipe, &g_pipe_overlapped, &written, TRUE);
+	}
+
+	FlushFileBuffers(g_pipe);
+	DisconnectNamedPipe(g_pipe);
+
+	ConnectPipeClient();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Closes the notification handles and the pipe
+void WatchStop(void)
+{
+	int i;
+
+	for (i = 0; i < g_watched_directory_count; i++)
+		FindCloseChangeNotification(g_directory_handles[i]);
+
+	g_watched_directory_count = 0;
+	g_watched_file_count = 0;
+
+	if (g_pipe != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(g_pipe);
+		CloseHandle(g_pipe_overlapped.hEvent);
+		g_pipe = INVALID_HANDLE_VALUE;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds the directory of the file to the watched directories (if it is not watched yet)
+static bool AddWatchedDirectory(wchar_t* in_file_name)
+{
+	wchar_t directory[MAX_PATH];
+	wchar_t* file_part;
+	int i;
+
+	if (GetFullPathNameW(in_file_name, MAX_PATH, directory, &file_part) == 0 || file_part == NULL)
+	{
+		fwprintf(stderr, L"\nInvalid file name: %s", in_file_name);
+		return false;
+	}
+
+	*file_part = '\0';
+
+	for (i = 0; i < g_watched_directory_count; i++)
+	{
+		if (_wcsicmp(g_watched_directories[i], directory) == 0)
+			return true;
+	}
+
+	if (g_watched_directory_count >= WATCH_MAX_DIRECTORY_COUNT)
+	{
+		fwprintf(stderr, L"\nToo many directories to watch (maximum %d)!", WATCH_MAX_DIRECTORY_COUNT);
+		return false;
+	}
+
+	g_directory_handles[g_watched_directory_count] = FindFirstChangeNotificationW(directory, FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+	if (g_directory_handles[g_watched_directory_count] == INVALID_HANDLE_VALUE)
+	{
+		fwprintf(stderr, L"\nCan't watch directory: %s", directory);
+		return false;
+	}
+
+	wcscpy_s(g_watched_directories[g_watched_directory_count], MAX_PATH, directory);
+	g_watched_directory_count++;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the last write time and size of the file (zero if the file doesn't exist)
+static void GetWatchedFileState(WatchedFileInfo* inout_file_info, FILETIME* out_last_write_time, DWORD* out_file_size)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (GetFileAttributesExW(inout_file_info->FileName, GetFileExInfoStandard, &attributes))
+	{
+		*out_last_write_time = attributes.ftLastWriteTime;
+		*out_file_size = attributes.nFileSizeLow;
+	}
+	else
+	{
+		memset(out_last_write_time, 0, sizeof(FILETIME));
+		*out_file_size = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Starts waiting for the next client of the pipe (the event is set when a client is connected)
+static bool ConnectPipeClient(void)
+{
+	ResetEvent(g_pipe_overlapped.hEvent);
+
+	if (ConnectNamedPipe(g_pipe, &g_pipe_overlapped))
+	{
+		SetEvent(g_pipe_overlapped.hEvent);
+		return true;
+	}
+
+	switch (GetLastError())
+	{
+		case ERROR_IO_PENDING:
+			return true;
+
+		case ERROR_PIPE_CONNECTED:
+			SetEvent(g_pipe_overlapped.hEvent);
+			return true;
+
+		default:
+			fwprintf(stderr, L"\nPipe error!");
+			return false;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads one request line from the connected client (line ending is removed)
+static bool ReadPipeRequest(char* out_request, int in_buffer_length)
+{
+	DWORD length = 0;
+	DWORD read;
+	char* line_end;
+
+	while (length < (DWORD)in_buffer_length - 1)
+	{
+		if (!ReadFile(g_pipe, out_request + length, in_buffer_length - 1 - length, &read, &g_pipe_overlapped))
+		{
+			if (GetLastError() != ERROR_IO_PENDING || !GetOverlappedResult(g_pipe, &g_pipe_overlapped, &read, TRUE))
+				return false;
+		}
+
+		length += read;
+		out_request[length] = '\0';
+
+		line_end = strpbrk(out_request, "\r\n");
+		if (line_end != NULL)
+		{
+			*line_end = '\0';
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,3039 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Image builder library (in-memory image creation)                          */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <CASFile.h>
+#include <FileUtils.h>
+#include "KiloCart.h"
+#include "ZX7Compress.h"
+#include "ZX7Segmented.h"
+#include "ZX7Parallel.h"
+#include "ZX7Stats.h"
+#include "FastParse.h"
+#include "LZBCompress.h"
+#include "LoadTime.h"
+#include "CodeFilter.h"
+#include "VideoFilter.h"
+#include "Compressibility.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define FILE_BUFFER_SIZE 1024*1024
+#define LOADER_RAM_END 0x0f00			// native files can't overwrite the RAM area used by the loader
+
+// Loader features (optional code fragments of the loader)
+#define LOADER_FEATURE_DECOMPRESSOR 0x01	// ZX7 decompressor
+#define LOADER_FEATURE_STREAM 0x02				// Decompression in chunks using the stream window
+#define LOADER_FEATURE_ASYNC 0x04					// Background loading
+#define LOADER_FEATURE_XIP 0x08						// Execute-in-place call
+#define LOADER_FEATURE_NATIVE 0x10				// Native machine code autostart
+#define LOADER_FEATURE_LZB 0x20						// Byte-aligned LZ decompressor
+#define LOADER_FEATURE_FILTER 0x40					// Inverse filters of the loaded files
+#define LOADER_FEATURES_EXTENDED (LOADER_FEATURE_XIP | LOADER_FEATURE_NATIVE)
+
+// Stable layout
+#define STABLE_SPARE_DIRECTORY_ENTRIES 4		// Directory entries reserved for the new files
+
+// Fit mode
+#define FIT_KEPT_FILE 0											// Cartridge index of the kept files in the file selection
+#define FIT_DROPPED_FILE 1
+
+// Compressed file cache
+#define MAX_CACHE_ENTRY_COUNT (2 * MAX_FILE_NUMBER)	// compressed files of the last build and the changed files
+
+// ZX7 format
+#define ZX7_OFFSET_MARKER(offset_bits) (0x100 >> (offset_bits))	// bit marker of the decompressor which loads the extra bits
+
+// Load time estimation
+#define AUTOSTART_LOAD_TIME_WEIGHT 8						// Load time of the autostart file is more important than the others
+
+#define PRINT_ERROR(builder, ...) PrintMessage(builder, true, __VA_ARGS__)
+#define PRINT_INFO(builder, ...) PrintMessage(builder, false, __VA_ARGS__)
+
+///////////////////////////////////////////////////////////////////////////////
+// Loader binary data
+extern const long int kilocart_loader_bin_size;
+extern const unsigned char kilocart_loader_bin[];
+
+extern const long int kilocart_decomp_loader_bin_size;
+extern const unsigned char kilocart_decomp_loader_bin[];
+
+extern const long int kilocart_stream_loader_bin_size;
+extern const unsigned char kilocart_stream_loader_bin[];
+
+extern const long int kilocart_async_loader_bin_size;
+extern const unsigned char kilocart_async_loader_bin[];
+
+extern const long int kilocart_async_stream_loader_bin_size;
+extern const unsigned char kilocart_async_stream_loader_bin[];
+
+extern const long int kilocart_core_loader_bin_size;
+extern const unsigned char kilocart_core_loader_bin[];
+
+extern const long int kilocart_core_decomp_loader_bin_size;
+extern const unsigned char kilocart_core_decomp_loader_bin[];
+
+extern const long int kilocart_core_stream_loader_bin_size;
+extern const unsigned char kilocart_core_stream_loader_bin[];
+
+extern const long int kilocart_core_async_loader_bin_size;
+extern const unsigned char kilocart_core_async_loader_bin[];
+
+extern const long int kilocart_core_async_stream_loader_bin_size;
+extern const unsigned char kilocart_core_async_stream_loader_bin[];
+
+extern const long int kilocart_lzb_loader_bin_size;
+extern const unsigned char kilocart_lzb_loader_bin[];
+
+extern const long int kilocart_lzb_decomp_loader_bin_size;
+extern const unsigned char kilocart_lzb_decomp_loader_bin[];
+
+extern const long int kilocart_core_lzb_loader_bin_size;
+extern const unsigned char kilocart_core_lzb_loader_bin[];
+
+extern const long int kilocart_core_lzb_decomp_loader_bin_size;
+extern const unsigned char kilocart_core_lzb_decomp_loader_bin[];
+
+extern const long int kilocart_filter_decomp_loader_bin_size;
+extern const unsigned char kilocart_filter_decomp_loader_bin[];
+
+extern const long int kilocart_filter_lzb_loader_bin_size;
+extern const unsigned char kilocart_filter_lzb_loader_bin[];
+
+extern const long int kilocart_filter_lzb_decomp_loader_bin_size;
+extern const unsigned char kilocart_filter_lzb_decomp_loader_bin[];
+
+extern const long int kilocart_core_filter_decomp_loader_bin_size;
+extern const unsigned char kilocart_core_filter_decomp_loader_bin[];
+
+extern const long int kilocart_core_filter_lzb_loader_bin_size;
+extern const unsigned char kilocart_core_filter_lzb_loader_bin[];
+
+extern const long int kilocart_core_filter_lzb_decomp_loader_bin_size;
+extern const unsigned char kilocart_core_filter_lzb_decomp_loader_bin[];
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Storage modes of the files
+typedef enum
+{
+	STORAGE_RAW,		// uncompressed
+	STORAGE_ZX7,		// compressed by ZX7 (best ratio)
+	STORAGE_LZB,		// compressed by the byte-aligned LZ codec (fast decompression)
+	STORAGE_MODE_COUNT
+} StorageMode;
+
+typedef struct 
+{
+	wchar_t Filename[MAX_PATH_LENGTH];
+	int BufferPos;
+	int ROMAddress;
+	int Length;
+	bool Version2xFile;
+	bool StreamFile;
+	bool XIPFile;
+	bool VideoFile;
+	bool NativeFile;
+	int LoadAddress;
+	int EntryAddress;
+	StorageMode Mode;													// Storage mode of the file
+	uint8_t* StoredData[STORAGE_MODE_COUNT];	// File content in the storage modes (NULL when the file can't be stored in the mode)
+	int StoredLength[STORAGE_MODE_COUNT];
+	int FilterOptions;												// Filters tried before compression (ROM_FILE_FLAG_CODE_FILTER, ROM_FILE_FLAG_ROW_DELTA)
+	int Filters[STORAGE_MODE_COUNT];					// Filters applied to the stored data of the mode
+	int PreviousROMAddress;		// Address of the file in the previous ROM image (-1 if it is a new file)
+	int Group;								// Files of the same group are stored on the same cartridge (-1 if the file is not in a group)
+	CompressibilityEstimate Compressibility;	// Pre-screen result (incompressible files are stored raw)
+	int Priority;							// Value of the file when the files are selected to fit into the cartridge
+} ProgramFileInfo;
+
+typedef struct
+{
+	int Start;
+	int End;
+} ROMArea;
+
+// Content of a cartridge in multi-cartridge mode
+typedef struct
+{
+	int FileIndex[MAX_FILE_NUMBER];		// Index of the files in the input file list
+	StorageMode Mode[MAX_FILE_NUMBER];	// Storage mode of the files on this cartridge
+	int FileCount;
+	int UsedBytes;
+} CartridgeInfo;
+
+typedef struct
+{
+	unsigned int Features;	// Code fragments assembled into the loader (LOADER_FEATURE_xxx)
+	const unsigned char* Binary;
+	const long int* Length;
+} LoaderVariantInfo;
+
+// Compressed content of a file kept between the builds
+typedef struct
+{
+	uint32_t CRC;															// CRC32 of the file content
+	int Length;
+	bool StreamFile;
+	int FilterOptions;
+	int OffsetBits;														// Long offset width of the ZX7 content
+	CompressionLevel CompressionLevel;
+	bool ForceCompression;
+	bool SegmentedParse;
+	int ThreadCount;													// Segment count of the segmented parse depends on it
+	bool LZBAvailable;												// LZB content is created only if a loader variant can decode it
+	bool FilterAvailable;
+	uint8_t* StoredData[STORAGE_MODE_COUNT];	// Compressed content (raw content is not stored)
+	int StoredLength[STORAGE_MODE_COUNT];
+	int Filters[STORAGE_MODE_COUNT];
+	bool Used;																// Entry is used by the current build
+} CompressedFileCacheEntry;
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+	char Filename[MAX_TVC_FILE_NAME_LENGTH];
+	uint16_t Address;
+	uint16_t Length;
+	uint8_t Flags;
+	uint16_t LoadAddress;		// RAM address of the native autostart file
+	uint16_t EntryAddress;	// Start address of the native autostart file
+} ROMFileInfo;
+
+typedef struct
+{
+	uint8_t Files1xCount;	// Number of files in the image for 1.x TVC ROM version
+	uint8_t Files2xCount;	// Number of files in the image for 2.x TVC ROM version
+	uint16_t Directory1xAddress;	// Address of the directory for 1.x TVC ROM version
+	uint16_t Directory2xAddress;	// Address of the directory for 1.x TVC ROM version
+	uint16_t FilesAddress;				// Address of the file data
+} ROMFileSystemInfo;
+
+// Patchable parameters of the loader code (stored before the file system info)
+typedef struct
+{
+	uint16_t OffsetMarkerAddress;	// ROM address of the long offset bit marker of the ZX7 decompressor (0 if there is no decompressor)
+} ROMLoaderParameters;
+
+#pragma pack(pop)
+
+// Builder context
+struct KiloCartBuilderType
+{
+	KiloCartOptions Options;
+	wchar_t LastError[KILOCART_MAX_MESSAGE_LENGTH];
+
+	// input files
+	uint8_t FileBuffer[FILE_BUFFER_SIZE];
+	int FileBufferLength;
+	ProgramFileInfo FileInfo[MAX_FILE_NUMBER];						// Files of the image (all files except while the files of a cartridge are selected)
+	int FileInfoCount;
+	bool FilesCompressed;
+
+	// image
+	uint8_t ROMImage[FILE_BUFFER_SIZE];
+	int ROMImageAddress;
+	int ROMFileSystemInfoAddress;
+	int ROMFilesAddress;
+	int ROMUsedBytes;																			// Bytes used by the loader, directory and files of the last created image
+	bool ROMOverflow;																			// The files of the last created image didn't fit into the cartridge
+	bool CompressedMode;																	// at least one file is stored compressed
+	int OffsetBits;																				// extra bits of the long ZX7 offsets (window size of the format)
+	long long LoadTime;
+	int LayoutPassCount;																	// Number of the layouts created by the storage mode planning
+	int ImageFileCount;
+	int DroppedFileCount;
+
+	// previous image of the stable layout
+	bool PreviousImageValid;
+	uint8_t PreviousROMImage[CART_ROM_SIZE];
+	ROMFileInfo PreviousFileInfo[2 * MAX_FILE_NUMBER];
+	int PreviousFileInfoCount;
+	int PreviousFilesAddress;
+
+	// multi-cartridge and fit mode
+	ProgramFileInfo InputFileInfo[MAX_FILE_NUMBER];				// All files, the file list of the cartridges is selected from it
+	int InputFileInfoCount;
+	int FileCartridge[MAX_FILE_NUMBER];										// Cartridge index of the input files (-1 if the file is stored on every cartridge)
+	CartridgeInfo Cartridges[MAX_CARTRIDGE_COUNT];
+	int CartridgeCount;
+
+	// compressed content of the files of the previous builds
+	CompressedFileCacheEntry CompressedCache[MAX_CACHE_ENTRY_COUNT];
+	int CompressedCacheCount;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static void PrintMessage(KiloCartBuilder* in_builder, bool in_error, wchar_t* in_format, ...);
+static bool CreateROMImage(KiloCartBuilder* inout_builder);
+static bool PartitionFiles(KiloCartBuilder* inout_builder, int in_cartridge_count);
+static int GetFileItems(KiloCartBuilder* in_builder, int* out_item, int* out_item_length);
+static bool CreateFittingROMImage(KiloCartBuilder* inout_builder);
+static bool SelectFilesToKeep(KiloCartBuilder* inout_builder, int in_capacity_reduction, int in_table_capacity, long long* inout_value, uint8_t* inout_selected);
+static int GetMinimumOverflow(KiloCartBuilder* inout_builder);
+static int GetShortestStoredLength(ProgramFileInfo* in_file_info);
+static void PrintDroppedFiles(KiloCartBuilder* in_builder);
+static void SelectCartridgeFiles(KiloCartBuilder* inout_builder, CartridgeInfo* inout_cartridge, int in_cartridge_index);
+static bool IsCommonFile(KiloCartBuilder* in_builder, int in_input_index);
+static bool CreateROMLoader(KiloCartBuilder* inout_builder);
+static bool CreateROMDirectory(KiloCartBuilder* inout_builder);
+static bool CreateROMFileSystem(KiloCartBuilder* inout_builder);
+static void CopyToROMImage(KiloCartBuilder* inout_builder, uint8_t* in_source, int in_length);
+static void FillROMImage(KiloCartBuilder* inout_builder, int in_end_address);
+static void AlignROMAddressToPage(KiloCartBuilder* inout_builder);
+static bool CreateStableROMFileSystem(KiloCartBuilder* inout_builder, int* in_file_order, bool in_keep_previous);
+static int FindFreeROMArea(KiloCartBuilder* in_builder, ROMArea* in_used_areas, int in_used_area_count, int in_length, bool in_xip, bool in_use_slack);
+static int GetROMAreaEnd(int in_address, int in_length);
+static void AddUsedROMArea(ROMArea* inout_used_areas, int* inout_used_area_count, int in_address, int in_end_address);
+static void GetTVCFileName(ProgramFileInfo* in_file_info, char* out_file_name);
+static void ConvertToUpperCase(wchar_t* inout_string);
+static void CopyFileName(wchar_t* out_file_name, wchar_t* in_file_name);
+static int FindPreviousFileInfo(KiloCartBuilder* in_builder, int in_index);
+static bool ReadPreviousDirectory(KiloCartBuilder* inout_builder);
+static void PrintStableLayout(KiloCartBuilder* in_builder);
+static uint8_t* CompressFileData(KiloCartBuilder* inout_builder, ProgramFileInfo* in_file_info, uint8_t* in_data, size_t* out_compressed_size);
+static uint8_t* CompressFileDataBest(KiloCartBuilder* inout_builder, uint8_t* in_data, size_t in_length, int in_max_offset, size_t* out_compressed_size);
+static int GetZX7MaxOffset(KiloCartBuilder* in_builder, ProgramFileInfo* in_file_info);
+static bool SelectOffsetBits(KiloCartBuilder* inout_builder);
+static bool CompressFiles(KiloCartBuilder* inout_builder);
+static bool IsIncompressibleFile(KiloCartBuilder* in_builder, ProgramFileInfo* in_file_info);
+static bool ApplyFilters(KiloCartBuilder* inout_builder, ProgramFileInfo* inout_file_info);
+static uint8_t* CreateFilteredData(ProgramFileInfo* in_file_info, int in_filters);
+static void ReleaseFiles(KiloCartBuilder* inout_builder);
+static bool PlanStorageModes(KiloCartBuilder* inout_builder);
+static bool LayoutROMImage(KiloCartBuilder* inout_builder);
+static bool SelectFilesToCompress(KiloCartBuilder* inout_builder, StorageMode* in_base_modes, int in_required_saving, bool* out_saved);
+static int GetStoredLength(ProgramFileInfo* in_file_info, StorageMode in_mode);
+static long long EstimateLoadTime(KiloCartBuilder* in_builder, ProgramFileInfo* in_file_info, StorageMode in_mode);
+static bool IsLZBAvailable(KiloCartBuilder* in_builder);
+static bool IsFilterAvailable(KiloCartBuilder* in_builder);
+static bool LoadFromCompressedCache(KiloCartBuilder* inout_builder, ProgramFileInfo* inout_file_info, bool in_lzb_available, bool in_filter_available);
+static void StoreInCompressedCache(KiloCartBuilder* inout_builder, ProgramFileInfo* in_file_info, bool in_lzb_available, bool in_filter_available);
+static bool IsMatchingCacheEntry(KiloCartBuilder* in_builder, CompressedFileCacheEntry* in_entry, bool in_lzb_available, bool in_filter_available);
+static void ReleaseCompressedCache(KiloCartBuilder* inout_builder, bool in_release_all);
+static bool PrintCompressionStats(KiloCartBuilder* in_builder);
+static StorageMode GetStorageModeFromFlags(int in_flags);
+static long long PrintLoadTimes(KiloCartBuilder* in_builder);
+static bool IsAutostartFile(KiloCartBuilder* in_builder, int in_index);
+static int FindFirstFileInstance(KiloCartBuilder* in_builder, int in_index);
+static ROMFileSystemInfo* FindFileSystemInfo(uint8_t* in_image);
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables (constant, all state of the image building is stored in the builder)
+static const uint8_t l_page_start_bytes[ROM_PAGE_START_LENGTH] = { 'M', 'O', 'P', 'S', 0x3A, 0xFC, 0xFF };
+static const uint8_t l_page_end_bytes[] = { 0x00, 0x01, 0x02, 0x03 };
+
+// available loader variants (core variants don't contain the execute-in-place and native autostart fragments)
+static const LoaderVariantInfo l_loader_variants[] =
+{
+	{ 0, kilocart_core_loader_bin, &kilocart_core_loader_bin_size },
+	{ LOADER_FEATURE_DECOMPRESSOR, kilocart_core_decomp_loader_bin, &kilocart_core_decomp_loader_bin_size },
+	{ LOADER_FEATURE_ASYNC, kilocart_core_async_loader_bin, &kilocart_core_async_loader_bin_size },
+	{ LOADER_FEATURE_DECOMPRESSOR | LOADER_FEATURE_STREAM, kilocart_core_stream_loader_bin, &kilocart_core_stream_loader_bin_size },
+	{ LOADER_FEATURE_DECOMPRESSOR | LOADER_FEATURE_STREAM | LOADER_FEATURE_ASYNC, kilocart_core_async_stream_loader_bin, &kilocart_core_async_stream_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED, kilocart_loader_bin, &kilocart_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_DECOMPRESSOR, kilocart_decomp_loader_bin, &kilocart_decomp_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_ASYNC, kilocart_async_loader_bin, &kilocart_async_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_DECOMPRESSOR | LOADER_FEATURE_STREAM, kilocart_stream_loader_bin, &kilocart_stream_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_DECOMPRESSOR | LOADER_FEATURE_STREAM | LOADER_FEATURE_ASYNC, kilocart_async_stream_loader_bin, &kilocart_async_stream_loader_bin_size },
+	{ LOADER_FEATURE_LZB, kilocart_core_lzb_loader_bin, &kilocart_core_lzb_loader_bin_size },
+	{ LOADER_FEATURE_LZB | LOADER_FEATURE_DECOMPRESSOR, kilocart_core_lzb_decomp_loader_bin, &kilocart_core_lzb_decomp_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_LZB, kilocart_lzb_loader_bin, &kilocart_lzb_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_LZB | LOADER_FEATURE_DECOMPRESSOR, kilocart_lzb_decomp_loader_bin, &kilocart_lzb_decomp_loader_bin_size },
+	{ LOADER_FEATURE_FILTER | LOADER_FEATURE_DECOMPRESSOR, kilocart_core_filter_decomp_loader_bin, &kilocart_core_filter_decomp_loader_bin_size },
+	{ LOADER_FEATURE_FILTER | LOADER_FEATURE_LZB, kilocart_core_filter_lzb_loader_bin, &kilocart_core_filter_lzb_loader_bin_size },
+	{ LOADER_FEATURE_FILTER | LOADER_FEATURE_LZB | LOADER_FEATURE_DECOMPRESSOR, kilocart_core_filter_lzb_decomp_loader_bin, &kilocart_core_filter_lzb_decomp_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_FILTER | LOADER_FEATURE_DECOMPRESSOR, kilocart_filter_decomp_loader_bin, &kilocart_filter_decomp_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_FILTER | LOADER_FEATURE_LZB, kilocart_filter_lzb_loader_bin, &kilocart_filter_lzb_loader_bin_size },
+	{ LOADER_FEATURES_EXTENDED | LOADER_FEATURE_FILTER | LOADER_FEATURE_LZB | LOADER_FEATURE_DECOMPRESSOR, kilocart_filter_lzb_decomp_loader_bin, &kilocart_filter_lzb_decomp_loader_bin_size }
+};
+#define LOADER_VARIANT_COUNT ((int)(sizeof(l_loader_variants) / sizeof(l_loader_variants[0])))
+
+static const wchar_t* l_storage_mode_names[] = { L"raw", L"ZX7", L"LZB" };
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the default options of the builder
+void KiloCartGetDefaultOptions(KiloCartOptions* out_options)
+{
+	memset(out_options, 0, sizeof(KiloCartOptions));
+
+	out_options->CompressionLevel = COMPRESSION_LEVEL_OPTIMAL;
+	out_options->Prescreen = true;
+	out_options->ThreadCount = ZX7GetProcessorCount();	// one compression thread per processor
+	out_options->OffsetBits = OFFSET_BITS;
+	out_options->DecodeBudget = -1;
+	out_options->PageSlack = DEFAULT_PAGE_SLACK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the default options of the input files
+void KiloCartGetDefaultFileOptions(KiloCartFileOptions* out_options)
+{
+	memset(out_options, 0, sizeof(KiloCartFileOptions));
+
+	out_options->Group = -1;
+	out_options->Priority = DEFAULT_FILE_PRIORITY;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates a builder with the given options (default options are used if it is NULL).
+// Returns NULL if there is not enough memory.
+KiloCartBuilder* KiloCartCreate(KiloCartOptions* in_options)
+{
+	KiloCartBuilder* builder;
+
+	builder = (KiloCartBuilder*)calloc(1, sizeof(KiloCartBuilder));
+	if (builder == NULL)
+		return NULL;
+
+	if (in_options != NULL)
+		builder->Options = *in_options;
+	else
+		KiloCartGetDefaultOptions(&builder->Options);
+
+	builder->OffsetBits = builder->Options.OffsetBits;
+
+	return builder;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases the builder and all data of the files
+void KiloCartRelease(KiloCartBuilder* in_builder)
+{
+	if (in_builder == NULL)
+		return;
+
+	ReleaseFiles(in_builder);
+	ReleaseCompressedCache(in_builder, true);
+
+	free(in_builder);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Changes the options of the builder. The compression options are used when the
+// files are compressed next time (after the files are added again).
+void KiloCartSetOptions(KiloCartBuilder* inout_builder, KiloCartOptions* in_options)
+{
+	inout_builder->Options = *in_options;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds a file to the image (the content is copied into the builder). The first
+// file (and the first 2.x file) is the autostart file.
+bool KiloCartAddFile(KiloCartBuilder* inout_builder, wchar_t* in_file_name, uint8_t* in_data, int in_length, KiloCartFileOptions* in_options)
+{
+	ProgramFileInfo* file_info;
+	StorageMode mode;
+	int i;
+
+	if (inout_builder->FileInfoCount >= MAX_FILE_NUMBER)
+	{
+		PRINT_ERROR(inout_builder, L"\nToo many files specified (maximum %d)!", MAX_FILE_NUMBER);
+		return false;
+	}
+
+	if (in_length < 0 || in_length > UINT16_MAX)
+	{
+		PRINT_ERROR(inout_builder, L"\nInvalid file length!");
+		return false;
+	}
+
+	if (inout_builder->FileBufferLength + in_length >= FILE_BUFFER_SIZE)
+	{
+		PRINT_ERROR(inout_builder, L"\nToo many file specified!");
+		return false;
+	}
+
+	// files with the same name share the stored data, it can be read only in one way
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		file_info = &inout_builder->FileInfo[i];
+
+		if (CompareFilenames(file_info->Filename, in_file_name) == 0 && (file_info->StreamFile != in_options->StreamFile ||
+			file_info->XIPFile != in_options->XIPFile || file_info->FilterOptions != in_options->FilterOptions))
+		{
+			PRINT_ERROR(inout_builder, L"\nFile is specified with different '-s', '-x', '-f' or '-b' options: %s", in_file_name);
+			return false;
+		}
+	}
+
+	// the new file is compressed together with the other files
+	if (inout_builder->FilesCompressed)
+	{
+		ReleaseFiles(inout_builder);
+		inout_builder->FilesCompressed = false;
+	}
+
+	file_info = &inout_builder->FileInfo[inout_builder->FileInfoCount];
+	memset(file_info, 0, sizeof(ProgramFileInfo));
+
+	CopyFileName(file_info->Filename, in_file_name);
+	file_info->Version2xFile = in_options->Version2xFile;
+	file_info->StreamFile = in_options->StreamFile;
+	file_info->XIPFile = in_options->XIPFile;
+	file_info->VideoFile = in_options->VideoFile;
+	file_info->FilterOptions = in_options->FilterOptions;
+	file_info->NativeFile = in_options->NativeFile;
+	file_info->LoadAddress = in_options->LoadAddress;
+	file_info->EntryAddress = in_options->EntryAddress;
+	file_info->Group = in_options->Group;
+	file_info->Priority = in_options->Priority;
+
+	for (mode = STORAGE_RAW; mode < STORAGE_MODE_COUNT; mode++)
+		file_info->StoredData[mode] = NULL;
+
+	memcpy(inout_builder->FileBuffer + inout_builder->FileBufferLength, in_data, in_length);
+	file_info->Length = in_length;
+	file_info->BufferPos = inout_builder->FileBufferLength;
+	file_info->ROMAddress = 0;
+
+	inout_builder->FileBufferLength += in_length;
+	inout_builder->FileInfoCount++;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds the program of a CAS file (UPM header, program header and program data) to the image
+bool KiloCartAddCASFile(KiloCartBuilder* inout_builder, wchar_t* in_file_name, uint8_t* in_cas_data, int in_cas_length, KiloCartFileOptions* in_options)
+{
+	CASUPMHeaderType upm_header;
+	CASProgramFileHeaderType program_header;
+	int header_length = (int)(sizeof(CASUPMHeaderType) + sizeof(CASProgramFileHeaderType));
+
+	if (in_cas_length < header_length)
+	{
+		PRINT_ERROR(inout_builder, L"\nFile load error!");
+		return false;
+	}
+
+	memcpy(&upm_header, in_cas_data, sizeof(upm_header));
+	memcpy(&program_header, in_cas_data + sizeof(upm_header), sizeof(program_header));
+
+	// check validity
+	if (!CASCheckHeaderValidity(&program_header) || !CASCheckUPMHeaderValidity(&upm_header))
+	{
+		PRINT_ERROR(inout_builder, L"\nInvalid file!");
+		return false;
+	}
+
+	if (header_length + program_header.FileLength > in_cas_length)
+	{
+		PRINT_ERROR(inout_builder, L"\nFile load error!");
+		return false;
+	}
+
+	return KiloCartAddFile(inout_builder, in_file_name, in_cas_data + header_length, program_header.FileLength, in_options);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Removes all files from the builder. The cached compressed content of the files
+// which were not used by the last build is released.
+void KiloCartClearFiles(KiloCartBuilder* inout_builder)
+{
+	ReleaseFiles(inout_builder);
+
+	if (inout_builder->FilesCompressed)
+		ReleaseCompressedCache(inout_builder, false);
+
+	inout_builder->FileInfoCount = 0;
+	inout_builder->FileBufferLength = 0;
+	inout_builder->FilesCompressed = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sets the previous image of the stable layout (the image is copied into the builder,
+// NULL removes the previous image). Returns false if the directory of the image can't be read.
+bool KiloCartSetPreviousImage(KiloCartBuilder* inout_builder, uint8_t* in_image)
+{
+	inout_builder->PreviousImageValid = false;
+	inout_builder->PreviousFileInfoCount = 0;
+	inout_builder->PreviousFilesAddress = 0;
+
+	if (in_image == NULL)
+		return true;
+
+	memcpy(inout_builder->PreviousROMImage, in_image, CART_ROM_SIZE);
+
+	inout_builder->PreviousImageValid = ReadPreviousDirectory(inout_builder);
+
+	return inout_builder->PreviousImageValid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compresses the files in all storage modes which can be used for them (it is done
+// by the build if the files are not compressed yet)
+bool KiloCartCompressFiles(KiloCartBuilder* inout_builder)
+{
+	if (inout_builder->FilesCompressed)
+		return true;
+
+	inout_builder->OffsetBits = inout_builder->Options.OffsetBits;
+
+	if (!CompressFiles(inout_builder))
+	{
+		// the content compressed before the error is released, the files are compressed again by the next build
+		ReleaseFiles(inout_builder);
+		return false;
+	}
+
+	inout_builder->FilesCompressed = true;
+
+	if (inout_builder->Options.PrintStats)
+		return PrintCompressionStats(inout_builder);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the ROM image of the files into the given CART_ROM_SIZE bytes buffer
+bool KiloCartBuildImage(KiloCartBuilder* inout_builder, uint8_t* out_image)
+{
+	bool success;
+
+	if (!KiloCartCompressFiles(inout_builder))
+		return false;
+
+	inout_builder->LayoutPassCount = 0;
+	inout_builder->DroppedFileCount = 0;
+	inout_builder->CartridgeCount = 0;
+
+	success = (inout_builder->Options.FitMode) ? CreateFittingROMImage(inout_builder) : CreateROMImage(inout_builder);
+
+	if (success)
+	{
+		memcpy(out_image, inout_builder->ROMImage, CART_ROM_SIZE);
+		inout_builder->CartridgeCount = 1;
+	}
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates as many ROM images as required for the files (starting from one image)
+// into the given buffer of MAX_CARTRIDGE_COUNT images. The autostart files are
+// stored on every cartridge, the other files are distributed with balanced fill.
+bool KiloCartBuildMultiCartridgeImages(KiloCartBuilder* inout_builder, uint8_t* out_images, int* out_cartridge_count)
+{
+	CartridgeInfo* cartridge_info;
+	int cartridge_count;
+	int cartridge;
+	int i;
+	bool success = false;
+	bool fatal_error = false;
+
+	*out_cartridge_count = 0;
+
+	if (inout_builder->Options.StableLayout || inout_builder->Options.FitMode)
+	{
+		PRINT_ERROR(inout_builder, L"\nStable layout and fit mode can't be used in multi-cartridge mode.");
+		return false;
+	}
+
+	if (!KiloCartCompressFiles(inout_builder))
+		return false;
+
+	inout_builder->LayoutPassCount = 0;
+	inout_builder->DroppedFileCount = 0;
+
+	// keep the complete file list, the file list of the cartridges is selected from it
+	memcpy(inout_builder->InputFileInfo, inout_builder->FileInfo, sizeof(ProgramFileInfo) * inout_builder->FileInfoCount);
+	inout_builder->InputFileInfoCount = inout_builder->FileInfoCount;
+
+	cartridge_count = 0;
+	while (!success && !fatal_error && cartridge_count < MAX_CARTRIDGE_COUNT)
+	{
+		cartridge_count++;
+
+		if (!PartitionFiles(inout_builder, cartridge_count))
+			continue;
+
+		// create the images of the cartridges
+		success = true;
+		for (cartridge = 0; cartridge < cartridge_count; cartridge++)
+		{
+			PRINT_INFO(inout_builder, L"\n\nCartridge %d of %d:", cartridge + 1, cartridge_count);
+
+			cartridge_info = &inout_builder->Cartridges[cartridge];
+
+			SelectCartridgeFiles(inout_builder, cartridge_info, cartridge);
+			if (!CreateROMImage(inout_builder))
+			{
+				success = false;
+				break;
+			}
+
+			memcpy(out_images + (size_t)cartridge * CART_ROM_SIZE, inout_builder->ROMImage, CART_ROM_SIZE);
+
+			cartridge_info->UsedBytes = inout_builder->ROMUsedBytes;
+			for (i = 0; i < inout_builder->FileInfoCount; i++)
+				cartridge_info->Mode[i] = inout_builder->FileInfo[i].Mode;
+		}
+
+		// the estimated length was too low, try again with more cartridges
+		if (!success && inout_builder->ROMOverflow)
+			PRINT_INFO(inout_builder, L"\nCartridge %d is full, distributing the files to %d cartridges.", cartridge + 1, cartridge_count + 1);
+
+		if (!success && !inout_builder->ROMOverflow)
+			fatal_error = true;
+	}
+
+	// restore the complete file list (compressed data is released from this list)
+	memcpy(inout_builder->FileInfo, inout_builder->InputFileInfo, sizeof(ProgramFileInfo) * inout_builder->InputFileInfoCount);
+	inout_builder->FileInfoCount = inout_builder->InputFileInfoCount;
+
+	if (!success && !fatal_error)
+		PRINT_ERROR(inout_builder, L"\nThe files don't fit into %d cartridges!", MAX_CARTRIDGE_COUNT);
+
+	if (success)
+	{
+		inout_builder->CartridgeCount = cartridge_count;
+		*out_cartridge_count = cartridge_count;
+	}
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads the directory of a ROM image (its address is determined by the loader variant).
+// The files of the 2.x directory are listed after the 1.x files (if it is a separate
+// directory). Returns the number of the entries or -1 if the image is unknown.
+int KiloCartGetDirectory(uint8_t* in_image, KiloCartDirectoryEntry* out_entries, int in_max_entry_count)
+{
+	ROMFileSystemInfo* file_system_info;
+	ROMFileInfo* file_info;
+	int directory_address;
+	int file_count;
+	int entry_count = 0;
+	int i;
+
+	file_system_info = FindFileSystemInfo(in_image);
+	if (file_system_info == NULL)
+		return -1;
+
+	for (i = 0; i < 2; i++)
+	{
+		directory_address = (i == 0) ? file_system_info->Directory1xAddress : file_system_info->Directory2xAddress;
+		file_count = (i == 0) ? file_system_info->Files1xCount : file_system_info->Files2xCount;
+
+		if (i == 1 && directory_address == file_system_info->Directory1xAddress)
+			break;
+
+		if (directory_address + file_count * (int)sizeof(ROMFileInfo) > CART_ROM_SIZE)
+			return -1;
+
+		for (; file_count > 0 && entry_count < in_max_entry_count; file_count--)
+		{
+			file_info = (ROMFileInfo*)(in_image + directory_address);
+			directory_address += sizeof(ROMFileInfo);
+
+			memcpy(out_entries[entry_count].Filename, file_info->Filename, MAX_TVC_FILE_NAME_LENGTH);
+			out_entries[entry_count].Filename[MAX_TVC_FILE_NAME_LENGTH] = '\0';
+			out_entries[entry_count].Address = file_info->Address;
+			out_entries[entry_count].Length = file_info->Length;
+			out_entries[entry_count].Flags = file_info->Flags;
+			out_entries[entry_count].LoadAddress = file_info->LoadAddress;
+			out_entries[entry_count].EntryAddress = file_info->EntryAddress;
+			out_entries[entry_count].Version2xFile = (i == 1);
+			entry_count++;
+		}
+	}
+
+	return entry_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the statistics of the last build
+void KiloCartGetStatistics(KiloCartBuilder* in_builder, KiloCartStatistics* out_statistics)
+{
+	int i;
+
+	memset(out_statistics, 0, sizeof(KiloCartStatistics));
+
+	out_statistics->InputFileCount = in_builder->FileInfoCount;
+	for (i = 0; i < in_builder->FileInfoCount; i++)
+		out_statistics->InputLength += in_builder->FileInfo[i].Length;
+
+	out_statistics->FileCount = in_builder->ImageFileCount;
+	out_statistics->UsedBytes = in_builder->ROMUsedBytes;
+	out_statistics->CompressedMode = in_builder->CompressedMode;
+	out_statistics->Overflow = in_builder->ROMOverflow;
+	out_statistics->OffsetBits = in_builder->OffsetBits;
+	out_statistics->LoadTime = in_builder->LoadTime;
+	out_statistics->LayoutPassCount = in_builder->LayoutPassCount;
+	out_statistics->CartridgeCount = in_builder->CartridgeCount;
+	out_statistics->DroppedFileCount = in_builder->DroppedFileCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Prints the directory of the cartridges of the last multi-cartridge build and the cartridge
+// of the files (the image file names are listed for the cartridges)
+void KiloCartPrintCatalog(KiloCartBuilder* in_builder, FILE* in_file, wchar_t (*in_image_file_names)[MAX_PATH_LENGTH])
+{
+	ProgramFileInfo* file_info;
+	wchar_t buffer[MAX_PATH_LENGTH];
+	int cartridge;
+	int i, k;
+
+	fwprintf(in_file, L"Cartridge catalog (%d files on %d cartridges)\n", in_builder->InputFileInfoCount, in_builder->CartridgeCount);
+
+	for (cartridge = 0; cartridge < in_builder->CartridgeCount; cartridge++)
+	{
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_image_file_names[cartridge]);
+		fwprintf(in_file, L"\nCartridge %d: %s (%d bytes used, %d bytes free)\n", cartridge + 1, buffer, in_builder->Cartridges[cartridge].UsedBytes, CART_ROM_SIZE - in_builder->Cartridges[cartridge].UsedBytes);
+
+		for (k = 0; k < in_builder->Cartridges[cartridge].FileCount; k++)
+		{
+			i = in_builder->Cartridges[cartridge].FileIndex[k];
+			file_info = &in_builder->InputFileInfo[i];
+
+			GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, file_info->Filename);
+			fwprintf(in_file, L"  %s: %s, %d bytes, %s%s\n", buffer, (file_info->Version2xFile) ? L"2.x" : L"1.x", file_info->Length,
+				l_storage_mode_names[in_builder->Cartridges[cartridge].Mode[k]], (in_builder->FileCartridge[i] < 0) ? L", every cartridge" : L"");
+		}
+	}
+
+	fwprintf(in_file, L"\nFiles:\n");
+	for (i = 0; i < in_builder->InputFileInfoCount; i++)
+	{
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_builder->InputFileInfo[i].Filename);
+
+		if (in_builder->FileCartridge[i] < 0)
+			fwprintf(in_file, L"  %s: every cartridge\n", buffer);
+		else
+			fwprintf(in_file, L"  %s: cartridge %d\n", buffer, in_builder->FileCartridge[i] + 1);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the message of the last error
+const wchar_t* KiloCartGetLastError(KiloCartBuilder* in_builder)
+{
+	const wchar_t* message = in_builder->LastError;
+
+	while (*message == '\n')
+		message++;
+
+	return message;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates CRC32 (IEEE 802.3) of the data
+uint32_t KiloCartCalculateCRC32(uint8_t* in_data, int in_length)
+{
+	uint32_t crc = 0xffffffff;
+	int i;
+	int bit;
+
+	for (i = 0; i < in_length; i++)
+	{
+		crc ^= in_data[i];
+
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+	}
+
+	return ~crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays a message (if the builder is verbose), errors are also stored as the last error
+static void PrintMessage(KiloCartBuilder* in_builder, bool in_error, wchar_t* in_format, ...)
+{
+	va_list args;
+
+	if (in_error)
+	{
+		va_start(args, in_format);
+		vswprintf(in_builder->LastError, KILOCART_MAX_MESSAGE_LENGTH, in_format, args);
+		va_end(args);
+	}
+
+	if (in_builder->Options.Verbose)
+	{
+		va_start(args, in_format);
+		vfwprintf((in_error) ? stderr : stdout, in_format, args);
+		va_end(args);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates ROM image
+static bool CreateROMImage(KiloCartBuilder* inout_builder)
+{
+	bool success = true;
+
+	inout_builder->ROMOverflow = false;
+
+	// select storage mode of the files (it also creates the file area of the image)
+	success = PlanStorageModes(inout_builder);
+
+	// add directory to the image
+	if (success)
+		success = CreateROMDirectory(inout_builder);
+
+	// display statistics
+	if (inout_builder->CompressedMode)
+		PRINT_INFO(inout_builder, L"\nCompressed mode statistic:");
+	else
+		PRINT_INFO(inout_builder, L"\nStorage statistics:");
+
+	PRINT_INFO(inout_builder, L" %d bytes used, %d bytes free (%d total bytes)", inout_builder->ROMImageAddress, CART_ROM_SIZE - inout_builder->ROMImageAddress, CART_ROM_SIZE);
+	inout_builder->ROMUsedBytes = inout_builder->ROMImageAddress;
+	inout_builder->ImageFileCount = inout_builder->FileInfoCount;
+	inout_builder->LoadTime = 0;
+
+	if (success)
+	{
+		inout_builder->LoadTime = PrintLoadTimes(inout_builder);
+
+		if (inout_builder->Options.StableLayout)
+			PrintStableLayout(inout_builder);
+	}
+
+	// fill remaining bytes with FFH
+	if (success)
+		FillROMImage(inout_builder, CART_ROM_SIZE);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Distributes the input files to the given number of cartridges. Files of a group
+// and files with the same name (they are stored once) are kept together, the largest
+// ones are placed first to the least filled cartridge. Returns false if the files
+// don't fit by the estimated (shortest) stored length.
+static bool PartitionFiles(KiloCartBuilder* inout_builder, int in_cartridge_count)
+{
+	int item[MAX_FILE_NUMBER];							// Files with the same item index are stored on the same cartridge
+	int item_length[MAX_FILE_NUMBER];
+	int item_cartridge[MAX_FILE_NUMBER];
+	int order[MAX_FILE_NUMBER];
+	int cartridge_length[MAX_CARTRIDGE_COUNT];
+	int order_count = 0;
+	int capacity;
+	int best;
+	int i, j, k;
+
+	capacity = GetFileItems(inout_builder, item, item_length);
+
+	// sort items by length
+	for (i = 0; i < inout_builder->InputFileInfoCount; i++)
+	{
+		if (item[i] != i || IsCommonFile(inout_builder, i))
+			continue;
+
+		for (j = order_count; j > 0 && item_length[order[j - 1]] < item_length[i]; j--)
+			order[j] = order[j - 1];
+
+		order[j] = i;
+		order_count++;
+	}
+
+	// place the largest items first to the least filled cartridge
+	for (k = 0; k < in_cartridge_count; k++)
+		cartridge_length[k] = 0;
+
+	for (j = 0; j < order_count; j++)
+	{
+		best = -1;
+		for (k = 0; k < in_cartridge_count; k++)
+		{
+			if (cartridge_length[k] + item_length[order[j]] <= capacity && (best < 0 || cartridge_length[k] < cartridge_length[best]))
+				best = k;
+		}
+
+		if (best < 0)
+			return false;
+
+		cartridge_length[best] += item_length[order[j]];
+		item_cartridge[order[j]] = best;
+	}
+
+	for (i = 0; i < inout_builder->InputFileInfoCount; i++)
+		inout_builder->FileCartridge[i] = (IsCommonFile(inout_builder, i)) ? -1 : item_cartridge[item[i]];
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Collects the input files which are stored together (files of a group and files
+// with the same name) into items (files with the same item index). The length of
+// the items is estimated by the shortest storage mode of their files, the common
+// files are not in the items. Returns the cartridge area which can be used for the items.
+static int GetFileItems(KiloCartBuilder* in_builder, int* out_item, int* out_item_length)
+{
+	int capacity;
+	int length;
+	int previous_item;
+	int i, j, k;
+
+	// cartridge area which can be used for the distributed files (the largest loader is assumed)
+	capacity = CART_ROM_SIZE - (CART_ROM_SIZE / CART_PAGE_SIZE) * (int)(sizeof(l_page_start_bytes) + sizeof(l_page_end_bytes));
+	length = 0;
+	for (i = 0; i < LOADER_VARIANT_COUNT; i++)
+	{
+		if (*l_loader_variants[i].Length > length)
+			length = *l_loader_variants[i].Length;
+	}
+	capacity -= length;
+
+	// collect files which are stored together
+	for (i = 0; i < in_builder->InputFileInfoCount; i++)
+	{
+		out_item[i] = i;
+		out_item_length[i] = 0;
+
+		for (j = 0; j < i; j++)
+		{
+			if (CompareFilenames(in_builder->InputFileInfo[i].Filename, in_builder->InputFileInfo[j].Filename) == 0 ||
+				(in_builder->InputFileInfo[i].Group >= 0 && in_builder->InputFileInfo[i].Group == in_builder->InputFileInfo[j].Group))
+			{
+				previous_item = out_item[i];
+				for (k = 0; k <= i; k++)
+				{
+					if (out_item[k] == previous_item)
+						out_item[k] = out_item[j];
+				}
+			}
+		}
+	}
+
+	// length of the items by the shortest storage mode of the files
+	for (i = 0; i < in_builder->InputFileInfoCount; i++)
+	{
+		// duplicated files are stored once
+		for (j = 0; j < i && CompareFilenames(in_builder->InputFileInfo[i].Filename, in_builder->InputFileInfo[j].Filename) != 0; j++)
+			;
+
+		length = (int)sizeof(ROMFileInfo);
+		if (j == i)
+			length += GetShortestStoredLength(&in_builder->InputFileInfo[i]);
+
+		if (IsCommonFile(in_builder, i))
+			capacity -= length;
+		else
+			out_item_length[out_item[i]] += length;
+	}
+
+	return capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the ROM image. If the files don't fit, the image is created from the
+// files with the highest total priority which fit into the cartridge.
+static bool CreateFittingROMImage(KiloCartBuilder* inout_builder)
+{
+	int item[MAX_FILE_NUMBER];
+	int item_length[MAX_FILE_NUMBER];
+	long long* value = NULL;
+	uint8_t* selected = NULL;
+	int capacity;
+	int capacity_reduction = 0;
+	bool success;
+	int i;
+
+	success = CreateROMImage(inout_builder);
+	if (success || !inout_builder->ROMOverflow)
+		return success;
+
+	// keep the complete file list, the files of the image are selected from it
+	memcpy(inout_builder->InputFileInfo, inout_builder->FileInfo, sizeof(ProgramFileInfo) * inout_builder->FileInfoCount);
+	inout_builder->InputFileInfoCount = inout_builder->FileInfoCount;
+
+	// tables of the selection are allocated for the largest capacity, the selection is repeated with reduced capacity
+	capacity = GetFileItems(inout_builder, item, item_length);
+	if (capacity >= 0)
+	{
+		value = (long long*)malloc(((size_t)capacity + 1) * sizeof(long long));
+		selected = (uint8_t*)malloc((size_t)inout_builder->InputFileInfoCount * (capacity + 1));
+		if (value == NULL || selected == NULL)
+		{
+			PRINT_ERROR(inout_builder, L"\nInsufficient memory!");
+			inout_builder->ROMOverflow = false;
+			capacity = -1;
+		}
+	}
+	else
+	{
+		PRINT_ERROR(inout_builder, L"\nThe autostart files don't fit into the cartridge!");
+	}
+
+	while (!success && capacity >= 0)
+	{
+		if (!SelectFilesToKeep(inout_builder, capacity_reduction, capacity, value, selected))
+		{
+			PRINT_ERROR(inout_builder, L"\nThe autostart files don't fit into the cartridge!");
+			break;
+		}
+
+		PRINT_INFO(inout_builder, L"\n\nCreating image from the files selected by priority:");
+
+		SelectCartridgeFiles(inout_builder, &inout_builder->Cartridges[0], FIT_KEPT_FILE);
+		success = CreateROMImage(inout_builder);
+
+		if (!success && !inout_builder->ROMOverflow)
+			break;
+
+		// the selection is based on the estimated capacity (largest loader, no page alignment of the execute-in-place files)
+		if (!success)
+			capacity_reduction += GetMinimumOverflow(inout_builder);
+	}
+
+	if (success)
+	{
+		PrintDroppedFiles(inout_builder);
+
+		for (i = 0; i < inout_builder->InputFileInfoCount; i++)
+		{
+			if (inout_builder->FileCartridge[i] == FIT_DROPPED_FILE)
+				inout_builder->DroppedFileCount++;
+		}
+	}
+
+	free(selected);
+	free(value);
+
+	// restore the complete file list (compressed data is released from this list)
+	memcpy(inout_builder->FileInfo, inout_builder->InputFileInfo, sizeof(ProgramFileInfo) * inout_builder->InputFileInfoCount);
+	inout_builder->FileInfoCount = inout_builder->InputFileInfoCount;
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Selects the items (files stored together) with the highest total priority which
+// fit into the cartridge by their shortest stored length (0/1 knapsack). The common
+// (autostart) files are always kept. The value and selected tables are allocated by
+// the caller for the given capacity. Returns false if the common files don't fit.
+static bool SelectFilesToKeep(KiloCartBuilder* inout_builder, int in_capacity_reduction, int in_table_capacity, long long* inout_value, uint8_t* inout_selected)
+{
+	int item[MAX_FILE_NUMBER];
+	int item_length[MAX_FILE_NUMBER];
+	long long item_value[MAX_FILE_NUMBER];
+	bool item_kept[MAX_FILE_NUMBER];
+	int item_list[MAX_FILE_NUMBER];
+	int item_count = 0;
+	int capacity;
+	int length;
+	int c;
+	int i, j;
+
+	capacity = GetFileItems(inout_builder, item, item_length) - in_capacity_reduction;
+	if (capacity < 0)
+		return false;
+	if (capacity > in_table_capacity)
+		capacity = in_table_capacity;
+
+	// value of the items is their total priority, from the equal priorities the one with more files is selected
+	for (i = 0; i < inout_builder->InputFileInfoCount; i++)
+	{
+		item_value[i] = 0;
+		item_kept[i] = false;
+	}
+
+	for (i = 0; i < inout_builder->InputFileInfoCount; i++)
+	{
+		if (IsCommonFile(inout_builder, i))
+			continue;
+
+		if (item_value[item[i]] == 0)
+			item_list[item_count++] = item[i];
+
+		item_value[item[i]] += (long long)inout_builder->InputFileInfo[i].Priority * (MAX_FILE_NUMBER + 1) + 1;
+	}
+
+	// value[c] is the maximum value of the items which fit into c bytes, selected is set
+	// if the item is used for the maximum value of c bytes (with the items before it)
+	memset(inout_value, 0, ((size_t)capacity + 1) * sizeof(long long));
+	memset(inout_selected, 0, (size_t)item_count * (capacity + 1));
+
+	for (j = 0; j < item_count; j++)
+	{
+		length = item_length[item_list[j]];
+
+		for (c = capacity; c >= length; c--)
+		{
+			if (inout_value[c - length] + item_value[item_list[j]] > inout_value[c])
+			{
+				inout_value[c] = inout_value[c - length] + item_value[item_list[j]];
+				inout_selected[(size_t)j * (capacity + 1) + c] = 1;
+			}
+		}
+	}
+
+	// collect the kept items
+	c = capacity;
+	for (j = item_count - 1; j >= 0; j--)
+	{
+		if (inout_selected[(size_t)j * (capacity + 1) + c] != 0)
+		{
+			item_kept[item_list[j]] = true;
+			c -= item_length[item_list[j]];
+		}
+	}
+
+	for (i = 0; i < inout_builder->InputFileInfoCount; i++)
+		inout_builder->FileCartridge[i] = (IsCommonFile(inout_builder, i)) ? -1 : ((item_kept[item[i]]) ? FIT_KEPT_FILE : FIT_DROPPED_FILE);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the number of bytes the selected files exceed the cartridge by when they are
+// stored in their shortest storage mode (at least one byte)
+static int GetMinimumOverflow(KiloCartBuilder* inout_builder)
+{
+	StorageMode mode;
+	int i;
+
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		for (mode = STORAGE_ZX7; mode < STORAGE_MODE_COUNT; mode++)
+		{
+			if (inout_builder->FileInfo[i].StoredData[mode] != NULL && inout_builder->FileInfo[i].StoredLength[mode] < inout_builder->FileInfo[i].StoredLength[inout_builder->FileInfo[i].Mode])
+				inout_builder->FileInfo[i].Mode = mode;
+		}
+	}
+
+	if (!LayoutROMImage(inout_builder) || inout_builder->ROMImageAddress < CART_ROM_SIZE)
+		return 1;
+
+	return inout_builder->ROMImageAddress - CART_ROM_SIZE + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the length of the file in its shortest storage mode
+static int GetShortestStoredLength(ProgramFileInfo* in_file_info)
+{
+	StorageMode mode;
+	int length;
+
+	length = in_file_info->StoredLength[STORAGE_RAW];
+	for (mode = STORAGE_ZX7; mode < STORAGE_MODE_COUNT; mode++)
+	{
+		if (in_file_info->StoredData[mode] != NULL && in_file_info->StoredLength[mode] < length)
+			length = in_file_info->StoredLength[mode];
+	}
+
+	return length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays the files which are left out of the image in fit mode
+static void PrintDroppedFiles(KiloCartBuilder* in_builder)
+{
+	int item[MAX_FILE_NUMBER];
+	int item_length[MAX_FILE_NUMBER];
+	wchar_t buffer[MAX_PATH_LENGTH];
+	int capacity;
+	int total_length = 0;
+	int dropped_count = 0;
+	int dropped_length = 0;
+	int dropped_priority = 0;
+	int i;
+
+	capacity = GetFileItems(in_builder, item, item_length);
+
+	for (i = 0; i < in_builder->InputFileInfoCount; i++)
+		total_length += item_length[i];
+
+	PRINT_INFO(in_builder, L"\n\nThe files exceed the cartridge by %d bytes (by their shortest stored length), dropped files:", total_length - capacity);
+
+	for (i = 0; i < in_builder->InputFileInfoCount; i++)
+	{
+		if (in_builder->FileCartridge[i] != FIT_DROPPED_FILE)
+			continue;
+
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_builder->InputFileInfo[i].Filename);
+		PRINT_INFO(in_builder, L"\n  %s (priority %d, %d bytes)", buffer, in_builder->InputFileInfo[i].Priority, GetShortestStoredLength(&in_builder->InputFileInfo[i]));
+
+		dropped_count++;
+		dropped_length += GetShortestStoredLength(&in_builder->InputFileInfo[i]);
+		dropped_priority += in_builder->InputFileInfo[i].Priority;
+	}
+
+	PRINT_INFO(in_builder, L"\n  Total: %d of %d files, %d bytes, priority %d", dropped_count, in_builder->InputFileInfoCount, dropped_length, dropped_priority);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sets the file list to the files of the given cartridge (in the input order)
+static void SelectCartridgeFiles(KiloCartBuilder* inout_builder, CartridgeInfo* inout_cartridge, int in_cartridge_index)
+{
+	int i;
+
+	inout_builder->FileInfoCount = 0;
+	for (i = 0; i < inout_builder->InputFileInfoCount; i++)
+	{
+		if (inout_builder->FileCartridge[i] < 0 || inout_builder->FileCartridge[i] == in_cartridge_index)
+		{
+			inout_cartridge->FileIndex[inout_builder->FileInfoCount] = i;
+			inout_builder->FileInfo[inout_builder->FileInfoCount++] = inout_builder->InputFileInfo[i];
+		}
+	}
+
+	inout_cartridge->FileCount = inout_builder->FileInfoCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true if the input file is stored on every cartridge (autostart files and
+// the files with the same name as an autostart file)
+static bool IsCommonFile(KiloCartBuilder* in_builder, int in_input_index)
+{
+	int i;
+
+	for (i = 0; i < in_builder->InputFileInfoCount; i++)
+	{
+		if ((i == 0 || in_builder->InputFileInfo[i].Version2xFile != in_builder->InputFileInfo[i - 1].Version2xFile) &&
+			CompareFilenames(in_builder->InputFileInfo[i].Filename, in_builder->InputFileInfo[in_input_index].Filename) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates loader code
+static bool CreateROMLoader(KiloCartBuilder* inout_builder)
+{
+	const LoaderVariantInfo* loader = NULL;
+	ROMLoaderParameters* parameters;
+	unsigned int features = 0;
+	int i;
+
+	// collect the features required by the files
+	inout_builder->CompressedMode = false;
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		if (inout_builder->FileInfo[i].Mode == STORAGE_ZX7)
+		{
+			features |= LOADER_FEATURE_DECOMPRESSOR;
+
+			if (inout_builder->FileInfo[i].StreamFile)
+				features |= LOADER_FEATURE_STREAM;
+		}
+
+		if (inout_builder->FileInfo[i].Mode == STORAGE_LZB)
+			features |= LOADER_FEATURE_LZB;
+
+		// filters are applied to the data of the first instance of the shared files
+		if (inout_builder->FileInfo[FindFirstFileInstance(inout_builder, i)].Filters[inout_builder->FileInfo[i].Mode] != 0)
+			features |= LOADER_FEATURE_FILTER;
+
+		if (inout_builder->FileInfo[i].Mode != STORAGE_RAW)
+			inout_builder->CompressedMode = true;
+
+		if (inout_builder->FileInfo[i].XIPFile)
+			features |= LOADER_FEATURE_XIP;
+
+		if (inout_builder->FileInfo[i].NativeFile)
+			features |= LOADER_FEATURE_NATIVE;
+	}
+
+	if (inout_builder->Options.AsyncMode)
+		features |= LOADER_FEATURE_ASYNC;
+
+	// select the smallest loader which contains all required features
+	for (i = 0; i < LOADER_VARIANT_COUNT; i++)
+	{
+		if ((l_loader_variants[i].Features & features) == features && (loader == NULL || *l_loader_variants[i].Length < *loader->Length))
+			loader = &l_loader_variants[i];
+	}
+
+	if (loader == NULL)
+	{
+		PRINT_ERROR(inout_builder, L"\nNo loader is available for the selected options!");
+		return false;
+	}
+
+	// copy loader to ROM image
+	memcpy(inout_builder->ROMImage, loader->Binary, *loader->Length);
+
+	// set the long offset width of the decompressor
+	parameters = (ROMLoaderParameters*)(inout_builder->ROMImage + *loader->Length - sizeof(ROMFileSystemInfo) - sizeof(ROMLoaderParameters));
+	if (parameters->OffsetMarkerAddress != 0)
+		inout_builder->ROMImage[parameters->OffsetMarkerAddress - CART_START_ADDRESS] = ZX7_OFFSET_MARKER(inout_builder->OffsetBits);
+
+	// update ROM address
+	inout_builder->ROMImageAddress = *loader->Length;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates directory on the ROM image
+static bool CreateROMDirectory(KiloCartBuilder* inout_builder)
+{
+	ROMFileInfo* file_info;
+	int file_info_address;
+	int file_count = 0;
+	bool file_system_version2x = false;
+	wchar_t buffer[MAX_PATH_LENGTH];
+
+	ROMFileSystemInfo* file_system_info = (ROMFileSystemInfo*)(inout_builder->ROMImage + inout_builder->ROMFileSystemInfoAddress);
+	file_system_info->FilesAddress = inout_builder->ROMFilesAddress;
+	file_system_info->Directory1xAddress = inout_builder->ROMFileSystemInfoAddress + sizeof(ROMFileSystemInfo);
+
+	// create directory entries
+	for (int i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		file_info_address = inout_builder->ROMFileSystemInfoAddress + sizeof(ROMFileSystemInfo) + i * sizeof(ROMFileInfo);
+		file_info = (ROMFileInfo*)(inout_builder->ROMImage + file_info_address);
+		memset(file_info, 0, sizeof(ROMFileInfo));	// the image buffer contains the previous build
+
+		// change to 2x ROM version if required
+		if (inout_builder->FileInfo[i].Version2xFile && !file_system_version2x)
+		{
+			file_system_version2x = true;
+			file_system_info->Files1xCount = (uint8_t)file_count;
+			file_count = 0;
+			file_system_info->Directory2xAddress = (uint16_t)file_info_address;
+		}
+
+		// convert and copy file name
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, inout_builder->FileInfo[i].Filename);
+		ConvertToUpperCase(buffer);
+		PCToTVCFilenameAndExtension(file_info->Filename, buffer);
+
+		file_info->Address = inout_builder->FileInfo[i].ROMAddress;
+		file_info->Length = (uint16_t)inout_builder->FileInfo[i].Length;
+		file_info->Flags = 0;
+		if (inout_builder->FileInfo[i].Mode == STORAGE_ZX7)
+		{
+			file_info->Flags |= ROM_FILE_FLAG_COMPRESSED;
+
+			if (inout_builder->FileInfo[i].StreamFile)
+				file_info->Flags |= ROM_FILE_FLAG_STREAM;
+		}
+
+		if (inout_builder->FileInfo[i].Mode == STORAGE_LZB)
+			file_info->Flags |= ROM_FILE_FLAG_LZB;
+
+		file_info->Flags |= inout_builder->FileInfo[FindFirstFileInstance(inout_builder, i)].Filters[inout_builder->FileInfo[i].Mode];
+
+		file_info->LoadAddress = 0;
+		file_info->EntryAddress = 0;
+
+		if (inout_builder->FileInfo[i].VideoFile)
+			file_info->Flags |= ROM_FILE_FLAG_VIDEO;
+
+		if (inout_builder->FileInfo[i].NativeFile)
+		{
+			file_info->Flags |= ROM_FILE_FLAG_NATIVE;
+			file_info->LoadAddress = (uint16_t)inout_builder->FileInfo[i].LoadAddress;
+			file_info->EntryAddress = (uint16_t)inout_builder->FileInfo[i].EntryAddress;
+			PRINT_INFO(inout_builder, L"\nNative autostart file: %s (load address 0x%04X, entry address 0x%04X)", buffer, inout_builder->FileInfo[i].LoadAddress, inout_builder->FileInfo[i].EntryAddress);
+		}
+
+		if (inout_builder->FileInfo[i].XIPFile)
+		{
+			file_info->Flags |= ROM_FILE_FLAG_XIP;
+			PRINT_INFO(inout_builder, L"\nExecute-in-place file: %s (page %d, address 0x%04X)", buffer, inout_builder->FileInfo[i].ROMAddress / CART_PAGE_SIZE, CART_START_ADDRESS + inout_builder->FileInfo[i].ROMAddress % CART_PAGE_SIZE);
+		}
+
+		file_count++;
+	}
+
+	// update file system info
+	if (file_system_version2x)
+	{
+		file_system_info->Files2xCount = file_count;
+	}
+	else
+	{
+		file_system_info->Files1xCount = file_count;
+		file_system_info->Directory2xAddress = file_system_info->Directory1xAddress;
+		file_system_info->Files2xCount = file_system_info->Files1xCount;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates files on the ROM image
+static bool CreateROMFileSystem(KiloCartBuilder* inout_builder)
+{
+	int i, j, k;
+	int file_order[MAX_FILE_NUMBER];
+
+	// execute-in-place files are placed after the other files (each of them starts a new page)
+	k = 0;
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		if (!inout_builder->FileInfo[i].XIPFile)
+			file_order[k++] = i;
+
+		// first file of the directory is the autostart file which can't be executed in place
+		if (inout_builder->FileInfo[i].XIPFile && (i == 0 || inout_builder->FileInfo[i].Version2xFile != inout_builder->FileInfo[i - 1].Version2xFile))
+		{
+			PRINT_ERROR(inout_builder, L"\nAutostart file can't be an execute-in-place file!");
+			return false;
+		}
+
+		// native file is started by the loader therefore only the autostart file can be native
+		if (inout_builder->FileInfo[i].NativeFile)
+		{
+			if (i != 0 && inout_builder->FileInfo[i].Version2xFile == inout_builder->FileInfo[i - 1].Version2xFile)
+			{
+				PRINT_ERROR(inout_builder, L"\nOnly the autostart file can be a native file!");
+				return false;
+			}
+
+			if (inout_builder->FileInfo[i].LoadAddress < LOADER_RAM_END || inout_builder->FileInfo[i].LoadAddress + inout_builder->FileInfo[i].Length > CART_START_ADDRESS)
+			{
+				PRINT_ERROR(inout_builder, L"\nNative file must be loaded between 0x%04X and 0x%04X!", LOADER_RAM_END, CART_START_ADDRESS);
+				return false;
+			}
+		}
+	}
+
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		if (inout_builder->FileInfo[i].XIPFile)
+			file_order[k++] = i;
+	}
+
+	// stable layout: if the files don't fit at their previous address, all files are placed again
+	if (inout_builder->Options.StableLayout)
+	{
+		if (!CreateStableROMFileSystem(inout_builder, file_order, true))
+			return false;
+
+		if (inout_builder->ROMImageAddress >= CART_ROM_SIZE && inout_builder->PreviousFileInfoCount > 0)
+			return CreateStableROMFileSystem(inout_builder, file_order, false);
+
+		return true;
+	}
+
+	// generate files in the ROM
+	for (k = 0; k < inout_builder->FileInfoCount; k++)
+	{
+		i = file_order[k];
+
+		// check if file is already in the ROM image
+		for (j = 0; j < k; j++)
+		{
+			if (CompareFilenames(inout_builder->FileInfo[i].Filename, inout_builder->FileInfo[file_order[j]].Filename) == 0)
+				break;
+		}
+
+		if (j < k)
+		{
+			// file already included in the image, copy only the address
+			inout_builder->FileInfo[i].ROMAddress = inout_builder->FileInfo[file_order[j]].ROMAddress;
+		}
+		else
+		{
+			if (inout_builder->FileInfo[i].XIPFile)
+			{
+				// execute-in-place file must fit into one page
+				if (inout_builder->FileInfo[i].Length > ROM_PAGE_CHANGE_ADDRESS - (int)sizeof(l_page_start_bytes))
+				{
+					PRINT_ERROR(inout_builder, L"\nExecute-in-place file is longer than a ROM page!");
+					return false;
+				}
+
+				AlignROMAddressToPage(inout_builder);
+			}
+
+			// update ROM address
+			inout_builder->FileInfo[i].ROMAddress = inout_builder->ROMImageAddress;
+
+			// copy file to the ROM image
+			CopyToROMImage(inout_builder, inout_builder->FileInfo[i].StoredData[inout_builder->FileInfo[i].Mode], inout_builder->FileInfo[i].StoredLength[inout_builder->FileInfo[i].Mode]);
+		}
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Copies data to the current ROM address (page change addresses are skipped)
+static void CopyToROMImage(KiloCartBuilder* inout_builder, uint8_t* in_source, int in_length)
+{
+	int byte_count;
+
+	for (byte_count = 0; byte_count < in_length; byte_count++)
+	{
+		if ((inout_builder->ROMImageAddress % CART_PAGE_SIZE) >= ROM_PAGE_CHANGE_ADDRESS)
+		{
+			// cover page change addresses with some less useful data
+			memcpy(inout_builder->ROMImage + inout_builder->ROMImageAddress, l_page_end_bytes, sizeof(l_page_end_bytes));
+			inout_builder->ROMImageAddress += sizeof(l_page_end_bytes);
+
+			// copy page start bytes
+			memcpy(inout_builder->ROMImage + inout_builder->ROMImageAddress, l_page_start_bytes, sizeof(l_page_start_bytes));
+			inout_builder->ROMImageAddress += sizeof(l_page_start_bytes);
+		}
+
+		inout_builder->ROMImage[inout_builder->ROMImageAddress++] = *in_source;
+		in_source++;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fills the ROM image with FFH from the current ROM address (page change addresses are covered)
+static void FillROMImage(KiloCartBuilder* inout_builder, int in_end_address)
+{
+	while (inout_builder->ROMImageAddress < in_end_address)
+	{
+		if ((inout_builder->ROMImageAddress % CART_PAGE_SIZE) >= ROM_PAGE_CHANGE_ADDRESS)
+		{
+			// cover page change addresses with some less useful data
+			memcpy(inout_builder->ROMImage + inout_builder->ROMImageAddress, l_page_end_bytes, sizeof(l_page_end_bytes));
+			inout_builder->ROMImageAddress += sizeof(l_page_end_bytes);
+
+			// copy page start bytes
+			memcpy(inout_builder->ROMImage + inout_builder->ROMImageAddress, l_page_start_bytes, sizeof(l_page_start_bytes));
+			inout_builder->ROMImageAddress += sizeof(l_page_start_bytes);
+		}
+
+		inout_builder->ROMImage[inout_builder->ROMImageAddress++] = 0xff;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Moves the ROM address to the data start of the next page (skipped bytes are filled with FFH)
+static void AlignROMAddressToPage(KiloCartBuilder* inout_builder)
+{
+	if ((inout_builder->ROMImageAddress % CART_PAGE_SIZE) == sizeof(l_page_start_bytes))
+		return;
+
+	while ((inout_builder->ROMImageAddress % CART_PAGE_SIZE) < ROM_PAGE_CHANGE_ADDRESS)
+		inout_builder->ROMImage[inout_builder->ROMImageAddress++] = 0xff;
+
+	// cover page change addresses with some less useful data
+	memcpy(inout_builder->ROMImage + inout_builder->ROMImageAddress, l_page_end_bytes, sizeof(l_page_end_bytes));
+	inout_builder->ROMImageAddress += sizeof(l_page_end_bytes);
+
+	// copy page start bytes
+	memcpy(inout_builder->ROMImage + inout_builder->ROMImageAddress, l_page_start_bytes, sizeof(l_page_start_bytes));
+	inout_builder->ROMImageAddress += sizeof(l_page_start_bytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates files on the ROM image keeping their address in the previous image when
+// they still fit there. Other files are placed into the free areas, the page slack
+// is used only when a file doesn't fit anywhere else.
+static bool CreateStableROMFileSystem(KiloCartBuilder* inout_builder, int* in_file_order, bool in_keep_previous)
+{
+	ROMArea used_areas[MAX_FILE_NUMBER];
+	int used_area_count = 0;
+	int candidates[MAX_FILE_NUMBER];
+	int candidate_count = 0;
+	int unplaced_length = 0;
+	int previous_index;
+	int end_address;
+	int limit_address;
+	int address;
+	int i, j, k;
+
+	// clear file area
+	FillROMImage(inout_builder, CART_ROM_SIZE);
+
+	// find the files of the previous image
+	for (k = 0; k < inout_builder->FileInfoCount; k++)
+	{
+		i = in_file_order[k];
+		inout_builder->FileInfo[i].ROMAddress = -1;
+		inout_builder->FileInfo[i].PreviousROMAddress = -1;
+
+		if (FindFirstFileInstance(inout_builder, i) != i)
+			continue;
+
+		previous_index = FindPreviousFileInfo(inout_builder, i);
+		if (previous_index >= 0)
+			inout_builder->FileInfo[i].PreviousROMAddress = inout_builder->PreviousFileInfo[previous_index].Address;
+
+		// keep candidates in the order of their previous address
+		if (in_keep_previous && inout_builder->FileInfo[i].PreviousROMAddress >= 0)
+		{
+			for (j = candidate_count; j > 0 && inout_builder->FileInfo[candidates[j - 1]].PreviousROMAddress > inout_builder->FileInfo[i].PreviousROMAddress; j--)
+				candidates[j] = candidates[j - 1];
+
+			candidates[j] = i;
+			candidate_count++;
+		}
+	}
+
+	// keep previous address if the file doesn't reach the next file of the previous image
+	for (j = 0; j < candidate_count; j++)
+	{
+		i = candidates[j];
+		address = inout_builder->FileInfo[i].PreviousROMAddress;
+		limit_address = (j + 1 < candidate_count) ? inout_builder->FileInfo[candidates[j + 1]].PreviousROMAddress : CART_ROM_SIZE;
+		end_address = GetROMAreaEnd(address, GetStoredLength(&inout_builder->FileInfo[i], inout_builder->FileInfo[i].Mode));
+
+		if (address < inout_builder->ROMFilesAddress || end_address > limit_address)
+			continue;
+
+		// execute-in-place file can't cross the page end
+		if (inout_builder->FileInfo[i].XIPFile && end_address > address - address % CART_PAGE_SIZE + ROM_PAGE_CHANGE_ADDRESS)
+			continue;
+
+		inout_builder->FileInfo[i].ROMAddress = address;
+		AddUsedROMArea(used_areas, &used_area_count, address, end_address);
+	}
+
+	// place new and changed files
+	for (k = 0; k < inout_builder->FileInfoCount; k++)
+	{
+		i = in_file_order[k];
+
+		if (FindFirstFileInstance(inout_builder, i) != i || inout_builder->FileInfo[i].ROMAddress >= 0)
+			continue;
+
+		address = FindFreeROMArea(inout_builder, used_areas, used_area_count, GetStoredLength(&inout_builder->FileInfo[i], inout_builder->FileInfo[i].Mode), inout_builder->FileInfo[i].XIPFile, false);
+		if (address < 0)
+			address = FindFreeROMArea(inout_builder, used_areas, used_area_count, GetStoredLength(&inout_builder->FileInfo[i], inout_builder->FileInfo[i].Mode), inout_builder->FileInfo[i].XIPFile, true);
+
+		// the shortest file which doesn't fit is the estimation of the missing bytes
+		if (address < 0)
+		{
+			if (unplaced_length == 0 || GetStoredLength(&inout_builder->FileInfo[i], inout_builder->FileInfo[i].Mode) < unplaced_length)
+				unplaced_length = GetStoredLength(&inout_builder->FileInfo[i], inout_builder->FileInfo[i].Mode);
+			continue;
+		}
+
+		inout_builder->FileInfo[i].ROMAddress = address;
+		AddUsedROMArea(used_areas, &used_area_count, address, GetROMAreaEnd(address, GetStoredLength(&inout_builder->FileInfo[i], inout_builder->FileInfo[i].Mode)));
+	}
+
+	// the image doesn't fit, storage mode planner needs the number of missing bytes
+	if (unplaced_length > 0)
+	{
+		inout_builder->ROMImageAddress = CART_ROM_SIZE - 1 + unplaced_length;
+		return true;
+	}
+
+	// copy files to the ROM image
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		if (FindFirstFileInstance(inout_builder, i) != i)
+		{
+			inout_builder->FileInfo[i].ROMAddress = inout_builder->FileInfo[FindFirstFileInstance(inout_builder, i)].ROMAddress;
+			inout_builder->FileInfo[i].PreviousROMAddress = inout_builder->FileInfo[FindFirstFileInstance(inout_builder, i)].PreviousROMAddress;
+			continue;
+		}
+
+		inout_builder->ROMImageAddress = inout_builder->FileInfo[i].ROMAddress;
+		CopyToROMImage(inout_builder, inout_builder->FileInfo[i].StoredData[inout_builder->FileInfo[i].Mode], inout_builder->FileInfo[i].StoredLength[inout_builder->FileInfo[i].Mode]);
+	}
+
+	// ROM address is the end of the last used area
+	inout_builder->ROMImageAddress = (used_area_count > 0) ? used_areas[used_area_count - 1].End : inout_builder->ROMFilesAddress;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds the first free area where the stored file fits (returns -1 if there is no such area)
+static int FindFreeROMArea(KiloCartBuilder* in_builder, ROMArea* in_used_areas, int in_used_area_count, int in_length, bool in_xip, bool in_use_slack)
+{
+	int area_start = in_builder->ROMFilesAddress;
+	int area_end;
+	int address;
+	int offset;
+	int i;
+
+	for (i = 0; i <= in_used_area_count; i++)
+	{
+		area_end = (i < in_used_area_count) ? in_used_areas[i].Start : CART_ROM_SIZE;
+
+		address = area_start;
+		while (address < area_end)
+		{
+			// files can't start at the page change addresses, execute-in-place files start at the page data start
+			offset = address % CART_PAGE_SIZE;
+			if (offset >= ROM_PAGE_CHANGE_ADDRESS || (in_xip && offset != sizeof(l_page_start_bytes)) || (!in_use_slack && offset >= ROM_PAGE_CHANGE_ADDRESS - in_builder->Options.PageSlack))
+				address = address - offset + CART_PAGE_SIZE + sizeof(l_page_start_bytes);
+
+			if (address >= area_end)
+				break;
+
+			if (GetROMAreaEnd(address, in_length) <= area_end &&
+				(!in_xip || GetROMAreaEnd(address, in_length) <= address - address % CART_PAGE_SIZE + ROM_PAGE_CHANGE_ADDRESS))
+				return address;
+
+			// only execute-in-place files can fit at a later page of the same area
+			if (!in_xip)
+				break;
+
+			address = address - address % CART_PAGE_SIZE + CART_PAGE_SIZE;
+		}
+
+		if (i < in_used_area_count)
+			area_start = in_used_areas[i].End;
+	}
+
+	return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the end address of the data stored from the given address (including the skipped page change addresses)
+static int GetROMAreaEnd(int in_address, int in_length)
+{
+	int i;
+
+	for (i = 0; i < in_length; i++)
+	{
+		if ((in_address % CART_PAGE_SIZE) >= ROM_PAGE_CHANGE_ADDRESS)
+			in_address += sizeof(l_page_end_bytes) + sizeof(l_page_start_bytes);
+
+		in_address++;
+	}
+
+	return in_address;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds area to the list of used areas (list is ordered by the start address)
+static void AddUsedROMArea(ROMArea* inout_used_areas, int* inout_used_area_count, int in_address, int in_end_address)
+{
+	int i;
+
+	for (i = *inout_used_area_count; i > 0 && inout_used_areas[i - 1].Start > in_address; i--)
+		inout_used_areas[i] = inout_used_areas[i - 1];
+
+	inout_used_areas[i].Start = in_address;
+	inout_used_areas[i].End = in_end_address;
+	(*inout_used_area_count)++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the file name which is stored in the ROM directory
+static void GetTVCFileName(ProgramFileInfo* in_file_info, char* out_file_name)
+{
+	wchar_t buffer[MAX_PATH_LENGTH];
+
+	GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_file_info->Filename);
+	ConvertToUpperCase(buffer);
+	PCToTVCFilenameAndExtension(out_file_name, buffer);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Converts the string to upper case in place
+static void ConvertToUpperCase(wchar_t* inout_string)
+{
+	while (*inout_string != L'\0')
+	{
+		*inout_string = (wchar_t)towupper(*inout_string);
+		inout_string++;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Copies the file name into a MAX_PATH_LENGTH buffer (longer names are truncated)
+static void CopyFileName(wchar_t* out_file_name, wchar_t* in_file_name)
+{
+#ifdef _MSC_VER
+	wcsncpy_s(out_file_name, MAX_PATH_LENGTH, in_file_name, _TRUNCATE);
+#else
+	size_t length;
+
+	length = wcslen(in_file_name);
+	if (length > MAX_PATH_LENGTH - 1)
+		length = MAX_PATH_LENGTH - 1;
+
+	memcpy(out_file_name, in_file_name, length * sizeof(wchar_t));
+	out_file_name[length] = L'\0';
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the index of the file in the directory of the previous ROM image (-1 if it is a new file)
+static int FindPreviousFileInfo(KiloCartBuilder* in_builder, int in_index)
+{
+	char file_name[MAX_TVC_FILE_NAME_LENGTH + 1];
+	int i;
+
+	GetTVCFileName(&in_builder->FileInfo[in_index], file_name);
+
+	for (i = 0; i < in_builder->PreviousFileInfoCount; i++)
+	{
+		if (strncmp(file_name, in_builder->PreviousFileInfo[i].Filename, MAX_TVC_FILE_NAME_LENGTH) == 0 &&
+			((in_builder->PreviousFileInfo[i].Flags & ROM_FILE_FLAG_XIP) != 0) == in_builder->FileInfo[in_index].XIPFile)
+			return i;
+	}
+
+	return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads the directory of the previous ROM image (its address is determined by the loader variant)
+static bool ReadPreviousDirectory(KiloCartBuilder* inout_builder)
+{
+	ROMFileSystemInfo* file_system_info;
+	ROMFileInfo* file_info;
+	int directory_address;
+	int file_count;
+	int i, j;
+
+	file_system_info = FindFileSystemInfo(inout_builder->PreviousROMImage);
+	if (file_system_info == NULL)
+	{
+		PRINT_ERROR(inout_builder, L"\nLoader of the previous ROM image is unknown, its layout can't be kept!");
+		return false;
+	}
+
+	// collect files of the 1.x and 2.x directories (shared files are listed once)
+	inout_builder->PreviousFileInfoCount = 0;
+	for (i = 0; i < 2; i++)
+	{
+		directory_address = (i == 0) ? file_system_info->Directory1xAddress : file_system_info->Directory2xAddress;
+		file_count = (i == 0) ? file_system_info->Files1xCount : file_system_info->Files2xCount;
+
+		if (i == 1 && directory_address == file_system_info->Directory1xAddress)
+			break;
+
+		if (directory_address + file_count * (int)sizeof(ROMFileInfo) > CART_ROM_SIZE)
+		{
+			PRINT_ERROR(inout_builder, L"\nInvalid directory in the previous ROM image!");
+			return false;
+		}
+
+		for (; file_count > 0; file_count--)
+		{
+			file_info = (ROMFileInfo*)(inout_builder->PreviousROMImage + directory_address);
+			directory_address += sizeof(ROMFileInfo);
+
+			for (j = 0; j < inout_builder->PreviousFileInfoCount; j++)
+			{
+				if (inout_builder->PreviousFileInfo[j].Address == file_info->Address)
+					break;
+			}
+
+			if (j == inout_builder->PreviousFileInfoCount)
+				inout_builder->PreviousFileInfo[inout_builder->PreviousFileInfoCount++] = *file_info;
+		}
+	}
+
+	inout_builder->PreviousFilesAddress = file_system_info->FilesAddress;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds the file system info of a ROM image by the longest loader variant which
+// matches the image (NULL if the loader is unknown)
+static ROMFileSystemInfo* FindFileSystemInfo(uint8_t* in_image)
+{
+	ROMFileSystemInfo* file_system_info = NULL;
+	int file_system_info_address;
+	int i;
+
+	for (i = 0; i < LOADER_VARIANT_COUNT; i++)
+	{
+		file_system_info_address = *l_loader_variants[i].Length - sizeof(ROMFileSystemInfo);
+
+		if (memcmp(in_image, l_loader_variants[i].Binary, file_system_info_address) == 0 &&
+			(file_system_info == NULL || (uint8_t*)file_system_info < in_image + file_system_info_address))
+			file_system_info = (ROMFileSystemInfo*)(in_image + file_system_info_address);
+	}
+
+	return file_system_info;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays the files which are not stored at their previous address
+static void PrintStableLayout(KiloCartBuilder* in_builder)
+{
+	wchar_t buffer[MAX_PATH_LENGTH];
+	int kept_count = 0;
+	int i;
+
+	PRINT_INFO(in_builder, L"\nStable layout: %d bytes page slack", in_builder->Options.PageSlack);
+
+	if (!in_builder->PreviousImageValid)
+		return;
+
+	for (i = 0; i < in_builder->FileInfoCount; i++)
+	{
+		if (FindFirstFileInstance(in_builder, i) != i)
+			continue;
+
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_builder->FileInfo[i].Filename);
+
+		if (in_builder->FileInfo[i].PreviousROMAddress < 0)
+			PRINT_INFO(in_builder, L"\nNew file: %s (0x%04X)", buffer, in_builder->FileInfo[i].ROMAddress);
+		else if (in_builder->FileInfo[i].PreviousROMAddress != in_builder->FileInfo[i].ROMAddress)
+			PRINT_INFO(in_builder, L"\nMoved file: %s (0x%04X -> 0x%04X)", buffer, in_builder->FileInfo[i].PreviousROMAddress, in_builder->FileInfo[i].ROMAddress);
+		else
+			kept_count++;
+	}
+
+	PRINT_INFO(in_builder, L"\n%d files are kept at their previous address", kept_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compresses file data (returns NULL if there is not enough memory)
+static uint8_t* CompressFileData(KiloCartBuilder* inout_builder, ProgramFileInfo* in_file_info, uint8_t* in_data, size_t* out_compressed_size)
+{
+	uint8_t* data = in_data;
+	size_t length = in_file_info->Length;
+	Optimal* optimal;
+	Optimal* exact_optimal;
+	uint8_t* compressed_data;
+	int max_offset;
+	int segment_count = 1;
+	wchar_t buffer[MAX_PATH_LENGTH];
+
+	max_offset = GetZX7MaxOffset(inout_builder, in_file_info);
+
+	switch (inout_builder->Options.CompressionLevel)
+	{
+		case COMPRESSION_LEVEL_FAST:
+			optimal = ZX7OptimizeFast(data, length, max_offset);
+			break;
+
+		case COMPRESSION_LEVEL_BEST:
+			return CompressFileDataBest(inout_builder, data, length, max_offset, out_compressed_size);
+
+		default:
+			if (inout_builder->Options.SegmentedParse)
+				optimal = ZX7OptimizeSegmented(data, length, max_offset, inout_builder->Options.ThreadCount, &segment_count);
+			else
+				optimal = ZX7OptimizeParallel(data, length, max_offset, inout_builder->Options.ThreadCount);
+			break;
+	}
+
+	if (optimal == NULL)
+		return NULL;
+
+	// report the cost of the segmented parse
+	if (inout_builder->Options.CompareExactParse && segment_count > 1)
+	{
+		exact_optimal = ZX7OptimizeParallel(data, length, max_offset, inout_builder->Options.ThreadCount);
+		if (exact_optimal == NULL)
+		{
+			ZX7FreeOptimal(optimal);
+			return NULL;
+		}
+
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_file_info->Filename);
+		PRINT_INFO(inout_builder, L"\n%s: %d segments, %+d bits (%+d bytes) compared to the exact parse", buffer, segment_count,
+			(int)optimal->bits[length - 1] - (int)exact_optimal->bits[length - 1],
+			(int)((optimal->bits[length - 1] + 18 + 7) / 8) - (int)((exact_optimal->bits[length - 1] + 18 + 7) / 8));
+
+		ZX7FreeOptimal(exact_optimal);
+	}
+
+	compressed_data = ZX7Compress(optimal, data, length, max_offset, out_compressed_size);
+
+	ZX7FreeOptimal(optimal);
+
+	return compressed_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compresses data by the exact optimal parse. The size optimal parse which prefers
+// the longest sequences has fewer sequences, both parses are created and the one
+// with the shorter decompression time is kept.
+static uint8_t* CompressFileDataBest(KiloCartBuilder* inout_builder, uint8_t* in_data, size_t in_length, int in_max_offset, size_t* out_compressed_size)
+{
+	MatchTable* matches;
+	Optimal* optimal;
+	uint8_t* compressed_data = NULL;
+	uint8_t* long_compressed_data = NULL;
+	size_t long_compressed_size;
+
+	matches = ZX7FindMatchesParallel(in_data, in_length, in_max_offset, inout_builder->Options.ThreadCount);
+	if (matches == NULL)
+		return NULL;
+
+	optimal = ZX7OptimizeMatches(matches, in_length, in_max_offset);
+	if (optimal != NULL)
+	{
+		compressed_data = ZX7Compress(optimal, in_data, in_length, in_max_offset, out_compressed_size);
+		ZX7FreeOptimal(optimal);
+	}
+
+	optimal = ZX7OptimizeMatchesLongest(matches, in_length, in_max_offset);
+	if (optimal != NULL)
+	{
+		long_compressed_data = ZX7Compress(optimal, in_data, in_length, in_max_offset, &long_compressed_size);
+		ZX7FreeOptimal(optimal);
+	}
+
+	ZX7FreeMatchTable(matches);
+
+	if (compressed_data == NULL || long_compressed_data == NULL)
+	{
+		free(compressed_data);
+		free(long_compressed_data);
+		return NULL;
+	}
+
+	if (long_compressed_size <= *out_compressed_size &&
+		EstimateDecompressionTime(long_compressed_data, (int)long_compressed_size, 0, inout_builder->OffsetBits) < EstimateDecompressionTime(compressed_data, (int)*out_compressed_size, 0, inout_builder->OffsetBits))
+	{
+		free(compressed_data);
+		compressed_data = long_compressed_data;
+		*out_compressed_size = long_compressed_size;
+	}
+	else
+	{
+		free(long_compressed_data);
+	}
+
+	return compressed_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the maximum ZX7 offset of the file (streamed files can use only the offsets
+// of the loader's decompression window)
+static int GetZX7MaxOffset(KiloCartBuilder* in_builder, ProgramFileInfo* in_file_info)
+{
+	return (in_file_info->StreamFile) ? STREAM_WINDOW_SIZE : MAX_OFFSET_OF(in_builder->OffsetBits);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Selects the long offset width of the ZX7 format which gives the shortest total
+// compressed length of the files (within the decompression time budget). The
+// matches of the widest format are collected once and parsed for every width.
+// Returns false if there is not enough memory.
+static bool SelectOffsetBits(KiloCartBuilder* inout_builder)
+{
+	long long total_length[MAX_OFFSET_BITS + 1];
+	long long total_time[MAX_OFFSET_BITS + 1];
+	MatchTable* matches;
+	Optimal* optimal;
+	uint8_t* data;
+	uint8_t* compressed_data;
+	size_t compressed_size;
+	int length;
+	int offset_bits;
+	int i;
+
+	memset(total_length, 0, sizeof(total_length));
+	memset(total_time, 0, sizeof(total_time));
+
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		// streamed files use short offsets only
+		if (inout_builder->FileInfo[i].XIPFile || inout_builder->FileInfo[i].StreamFile || FindFirstFileInstance(inout_builder, i) != i || inout_builder->FileInfo[i].Length == 0 || IsIncompressibleFile(inout_builder, &inout_builder->FileInfo[i]))
+			continue;
+
+		data = (uint8_t*)(inout_builder->FileBuffer + inout_builder->FileInfo[i].BufferPos);
+		length = inout_builder->FileInfo[i].Length;
+
+		matches = ZX7FindMatchesParallel(data, length, MAX_OFFSET_OF(MAX_OFFSET_BITS), inout_builder->Options.ThreadCount);
+		if (matches == NULL)
+			return false;
+
+		for (offset_bits = MIN_OFFSET_BITS; offset_bits <= MAX_OFFSET_BITS; offset_bits++)
+		{
+			optimal = ZX7OptimizeMatches(matches, length, MAX_OFFSET_OF(offset_bits));
+			if (optimal == NULL)
+			{
+				ZX7FreeMatchTable(matches);
+				return false;
+			}
+
+			if (inout_builder->Options.DecodeBudget >= 0)
+			{
+				compressed_data = ZX7Compress(optimal, data, length, MAX_OFFSET_OF(offset_bits), &compressed_size);
+				if (compressed_data == NULL)
+				{
+					ZX7FreeOptimal(optimal);
+					ZX7FreeMatchTable(matches);
+					return false;
+				}
+
+				total_time[offset_bits] += EstimateDecompressionTime(compressed_data, (int)compressed_size, 0, offset_bits);
+				free(compressed_data);
+			}
+			else
+			{
+				compressed_size = (optimal->bits[length - 1] + 18 + 7) / 8;
+			}
+
+			total_length[offset_bits] += compressed_size;
+
+			ZX7FreeOptimal(optimal);
+		}
+
+		ZX7FreeMatchTable(matches);
+	}
+
+	// the default width is always within the budget
+	inout_builder->OffsetBits = OFFSET_BITS;
+	for (offset_bits = MIN_OFFSET_BITS; offset_bits <= MAX_OFFSET_BITS; offset_bits++)
+	{
+		if (inout_builder->Options.DecodeBudget >= 0 && total_time[offset_bits] * 100 > total_time[OFFSET_BITS] * (100 + inout_builder->Options.DecodeBudget))
+			continue;
+
+		if (total_length[offset_bits] < total_length[inout_builder->OffsetBits])
+			inout_builder->OffsetBits = offset_bits;
+	}
+
+	PRINT_INFO(inout_builder, L"\nZX7 long offset width: %d bits (offsets up to %d bytes, %+d bytes compared to %d bits)", inout_builder->OffsetBits, MAX_OFFSET_OF(inout_builder->OffsetBits),
+		(int)(total_length[inout_builder->OffsetBits] - total_length[OFFSET_BITS]), OFFSET_BITS);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compresses the files in all storage modes which can be used for them. Returns
+// false if there is not enough memory.
+static bool CompressFiles(KiloCartBuilder* inout_builder)
+{
+	size_t compressed_size;
+	bool lzb_available = IsLZBAvailable(inout_builder);
+	bool filter_available = IsFilterAvailable(inout_builder);
+	StorageMode mode;
+	wchar_t buffer[MAX_PATH_LENGTH];
+	int i;
+
+	// compressibility pre-screen (it is cheap compared to the compression)
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		if (!EstimateCompressibility(inout_builder->FileBuffer + inout_builder->FileInfo[i].BufferPos, inout_builder->FileInfo[i].Length, GetZX7MaxOffset(inout_builder, &inout_builder->FileInfo[i]), &inout_builder->FileInfo[i].Compressibility))
+		{
+			PRINT_ERROR(inout_builder, L"\nInsufficient memory!");
+			return false;
+		}
+	}
+
+	if (inout_builder->Options.SearchOffsetBits && !SelectOffsetBits(inout_builder))
+	{
+		PRINT_ERROR(inout_builder, L"\nInsufficient memory!");
+		return false;
+	}
+
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		inout_builder->FileInfo[i].StoredData[STORAGE_RAW] = (uint8_t*)(inout_builder->FileBuffer + inout_builder->FileInfo[i].BufferPos);
+		inout_builder->FileInfo[i].StoredLength[STORAGE_RAW] = inout_builder->FileInfo[i].Length;
+		inout_builder->FileInfo[i].StoredData[STORAGE_ZX7] = NULL;
+		inout_builder->FileInfo[i].StoredLength[STORAGE_ZX7] = 0;
+		inout_builder->FileInfo[i].StoredData[STORAGE_LZB] = NULL;
+		inout_builder->FileInfo[i].StoredLength[STORAGE_LZB] = 0;
+
+		for (mode = STORAGE_RAW; mode < STORAGE_MODE_COUNT; mode++)
+			inout_builder->FileInfo[i].Filters[mode] = 0;
+
+		// execute-in-place and empty files are stored uncompressed, duplicated files are compressed only once
+		if (!inout_builder->FileInfo[i].XIPFile && FindFirstFileInstance(inout_builder, i) == i && inout_builder->FileInfo[i].Length > 0)
+		{
+			// incompressible files are stored raw
+			if (IsIncompressibleFile(inout_builder, &inout_builder->FileInfo[i]))
+			{
+				GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, inout_builder->FileInfo[i].Filename);
+				PRINT_INFO(inout_builder, L"\nIncompressible file: %s (order-0 %.2f, order-1 %.2f bits/byte, %.1f%% digram hits), stored raw", buffer,
+					inout_builder->FileInfo[i].Compressibility.Order0Entropy, inout_builder->FileInfo[i].Compressibility.Order1Entropy, inout_builder->FileInfo[i].Compressibility.DigramHitRate * 100);
+				continue;
+			}
+
+			// unchanged files are not compressed again in watch mode
+			if (inout_builder->Options.CacheCompressedFiles && LoadFromCompressedCache(inout_builder, &inout_builder->FileInfo[i], lzb_available, filter_available))
+				continue;
+
+			inout_builder->FileInfo[i].StoredData[STORAGE_ZX7] = CompressFileData(inout_builder, &inout_builder->FileInfo[i], inout_builder->FileInfo[i].StoredData[STORAGE_RAW], &compressed_size);
+			if (inout_builder->FileInfo[i].StoredData[STORAGE_ZX7] == NULL)
+			{
+				PRINT_ERROR(inout_builder, L"\nInsufficient memory!");
+				return false;
+			}
+			inout_builder->FileInfo[i].StoredLength[STORAGE_ZX7] = (int)compressed_size;
+
+			// streamed files are read in chunks which is supported only by the ZX7 stream decompressor
+			if (lzb_available && !inout_builder->FileInfo[i].StreamFile && !inout_builder->Options.ForceCompression)
+			{
+				inout_builder->FileInfo[i].StoredData[STORAGE_LZB] = LZBCompress(inout_builder->FileInfo[i].StoredData[STORAGE_RAW], inout_builder->FileInfo[i].Length, MAX_OFFSET, inout_builder->Options.CompressionLevel == COMPRESSION_LEVEL_FAST, &compressed_size);
+				if (inout_builder->FileInfo[i].StoredData[STORAGE_LZB] == NULL)
+				{
+					PRINT_ERROR(inout_builder, L"\nInsufficient memory!");
+					return false;
+				}
+				inout_builder->FileInfo[i].StoredLength[STORAGE_LZB] = (int)compressed_size;
+			}
+
+			// filters are undone after the whole file is loaded, streamed files are read in chunks
+			if (inout_builder->FileInfo[i].FilterOptions != 0 && filter_available && !inout_builder->FileInfo[i].StreamFile && !ApplyFilters(inout_builder, &inout_builder->FileInfo[i]))
+			{
+				PRINT_ERROR(inout_builder, L"\nInsufficient memory!");
+				return false;
+			}
+
+			if (inout_builder->Options.CacheCompressedFiles)
+				StoreInCompressedCache(inout_builder, &inout_builder->FileInfo[i], lzb_available, filter_available);
+		}
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Checks if the file is stored raw by the pre-screen (the filters can make the
+// content compressible, so filtered files are always compressed)
+static bool IsIncompressibleFile(KiloCartBuilder* in_builder, ProgramFileInfo* in_file_info)
+{
+	return in_builder->Options.Prescreen && in_file_info->Compressibility.Incompressible && in_file_info->FilterOptions == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compresses the filtered content of the file with every combination of the enabled
+// filters and uses it in those storage modes where it is shorter than the best one so far.
+// Returns false if there is not enough memory.
+static bool ApplyFilters(KiloCartBuilder* inout_builder, ProgramFileInfo* inout_file_info)
+{
+	uint8_t* filtered_data;
+	uint8_t* stored_data;
+	size_t stored_length;
+	StorageMode mode;
+	int filters;
+	wchar_t buffer[MAX_PATH_LENGTH];
+
+	GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, inout_file_info->Filename);
+
+	// all non-empty subsets of the filter options
+	for (filters = inout_file_info->FilterOptions; filters != 0; filters = (filters - 1) & inout_file_info->FilterOptions)
+	{
+		filtered_data = CreateFilteredData(inout_file_info, filters);
+		if (filtered_data == NULL)
+			return false;
+
+		PRINT_INFO(inout_builder, L"\nFilter (%s%s%s): %s:", ((filters & ROM_FILE_FLAG_CODE_FILTER) != 0) ? L"code" : L"",
+			(filters == ROM_FILE_FILTER_MASK) ? L", " : L"", ((filters & ROM_FILE_FLAG_ROW_DELTA) != 0) ? L"row delta" : L"", buffer);
+
+		for (mode = STORAGE_ZX7; mode < STORAGE_MODE_COUNT; mode++)
+		{
+			if (inout_file_info->StoredData[mode] == NULL)
+				continue;
+
+			if (mode == STORAGE_ZX7)
+				stored_data = CompressFileData(inout_builder, inout_file_info, filtered_data, &stored_length);
+			else
+				stored_data = LZBCompress(filtered_data, inout_file_info->Length, MAX_OFFSET, inout_builder->Options.CompressionLevel == COMPRESSION_LEVEL_FAST, &stored_length);
+
+			if (stored_data == NULL)
+			{
+				free(filtered_data);
+				return false;
+			}
+
+			PRINT_INFO(inout_builder, L"%s %s %d -> %d bytes (%+d, %s)", (mode == STORAGE_ZX7) ? L"" : L",", l_storage_mode_names[mode], inout_file_info->StoredLength[mode], (int)stored_length,
+				(int)stored_length - inout_file_info->StoredLength[mode], ((int)stored_length < inout_file_info->StoredLength[mode]) ? L"used" : L"not used");
+
+			if ((int)stored_length < inout_file_info->StoredLength[mode])
+			{
+				free(inout_file_info->StoredData[mode]);
+				inout_file_info->StoredData[mode] = stored_data;
+				inout_file_info->StoredLength[mode] = (int)stored_length;
+				inout_file_info->Filters[mode] = filters;
+			}
+			else
+			{
+				free(stored_data);
+			}
+		}
+
+		free(filtered_data);
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the filtered copy of the file content. The loader undoes the filters in
+// the reverse order (row delta first). Returns NULL if there is not enough memory.
+static uint8_t* CreateFilteredData(ProgramFileInfo* in_file_info, int in_filters)
+{
+	uint8_t* filtered_data;
+	uint8_t* code_filtered_data;
+
+	if ((in_filters & ROM_FILE_FLAG_CODE_FILTER) != 0)
+		filtered_data = EncodeCodeFilter(in_file_info->StoredData[STORAGE_RAW], in_file_info->Length);
+	else
+		filtered_data = in_file_info->StoredData[STORAGE_RAW];
+
+	if (filtered_data != NULL && (in_filters & ROM_FILE_FLAG_ROW_DELTA) != 0)
+	{
+		code_filtered_data = filtered_data;
+		filtered_data = EncodeVideoRowDelta(code_filtered_data, in_file_info->Length);
+
+		if (code_filtered_data != in_file_info->StoredData[STORAGE_RAW])
+			free(code_filtered_data);
+	}
+
+	return filtered_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases compressed file data
+static void ReleaseFiles(KiloCartBuilder* inout_builder)
+{
+	int i;
+
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		free(inout_builder->FileInfo[i].StoredData[STORAGE_ZX7]);
+		free(inout_builder->FileInfo[i].StoredData[STORAGE_LZB]);
+		inout_builder->FileInfo[i].StoredData[STORAGE_ZX7] = NULL;
+		inout_builder->FileInfo[i].StoredData[STORAGE_LZB] = NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Selects storage mode (raw, ZX7 or LZB) of the files. Every file is stored in
+// its fastest loading mode if the image fits, otherwise the storage modes are
+// changed to the smaller ones with the minimum increase of the (autostart weighted)
+// load time.
+static bool PlanStorageModes(KiloCartBuilder* inout_builder)
+{
+	StorageMode base_modes[MAX_FILE_NUMBER];
+	StorageMode mode;
+	int required_saving = 0;
+	int previous_index;
+	bool saved;
+	wchar_t buffer[MAX_PATH_LENGTH];
+	int i;
+
+	// start with the fastest storage mode of every file (or with the mode of the previous image in stable layout)
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		previous_index = (inout_builder->Options.StableLayout) ? FindPreviousFileInfo(inout_builder, i) : -1;
+
+		base_modes[i] = STORAGE_RAW;
+
+		if (inout_builder->Options.ForceCompression && inout_builder->FileInfo[i].StoredData[STORAGE_ZX7] != NULL)
+		{
+			base_modes[i] = STORAGE_ZX7;
+		}
+		else if (previous_index >= 0 && inout_builder->FileInfo[i].StoredData[GetStorageModeFromFlags(inout_builder->PreviousFileInfo[previous_index].Flags)] != NULL)
+		{
+			base_modes[i] = GetStorageModeFromFlags(inout_builder->PreviousFileInfo[previous_index].Flags);
+		}
+		else
+		{
+			for (mode = STORAGE_ZX7; mode < STORAGE_MODE_COUNT; mode++)
+			{
+				if (inout_builder->FileInfo[i].StoredData[mode] != NULL && EstimateLoadTime(inout_builder, &inout_builder->FileInfo[i], mode) < EstimateLoadTime(inout_builder, &inout_builder->FileInfo[i], base_modes[i]))
+					base_modes[i] = mode;
+			}
+		}
+
+		inout_builder->FileInfo[i].Mode = base_modes[i];
+	}
+
+	// compress more files until the image fits
+	while (true)
+	{
+		for (i = 0; i < inout_builder->FileInfoCount; i++)
+			inout_builder->FileInfo[i].Mode = inout_builder->FileInfo[FindFirstFileInstance(inout_builder, i)].Mode;
+
+		inout_builder->LayoutPassCount++;
+
+		if (!LayoutROMImage(inout_builder))
+			return false;
+
+		if (inout_builder->ROMImageAddress < CART_ROM_SIZE)
+			break;
+
+		required_saving += inout_builder->ROMImageAddress - CART_ROM_SIZE + 1;
+
+		if (!SelectFilesToCompress(inout_builder, base_modes, required_saving, &saved))
+		{
+			PRINT_ERROR(inout_builder, L"\nInsufficient memory!");
+			return false;
+		}
+
+		if (!saved)
+		{
+			PRINT_ERROR(inout_builder, L"\nCartridge memory is too low!");
+			inout_builder->ROMOverflow = true;
+			return false;
+		}
+	}
+
+	// display selected storage modes
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		if (inout_builder->FileInfo[i].Mode != STORAGE_RAW && FindFirstFileInstance(inout_builder, i) == i)
+		{
+			GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, inout_builder->FileInfo[i].Filename);
+			PRINT_INFO(inout_builder, L"\nCompressed file: %s (%d -> %d bytes, %s)", buffer, inout_builder->FileInfo[i].Length, inout_builder->FileInfo[i].StoredLength[inout_builder->FileInfo[i].Mode], l_storage_mode_names[inout_builder->FileInfo[i].Mode]);
+		}
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates loader and file area of the ROM image using the current storage modes
+static bool LayoutROMImage(KiloCartBuilder* inout_builder)
+{
+	int i;
+
+	inout_builder->ROMImageAddress = 0;
+
+	// load loader code
+	if (!CreateROMLoader(inout_builder))
+		return false;
+
+	// update addresses
+	inout_builder->ROMFileSystemInfoAddress = inout_builder->ROMImageAddress - sizeof(ROMFileSystemInfo);
+	inout_builder->ROMFilesAddress = inout_builder->ROMFileSystemInfoAddress + sizeof(ROMFileSystemInfo) + sizeof(ROMFileInfo) * inout_builder->FileInfoCount;
+
+	// stable layout: file area start doesn't depend on the loader variant and the number of files
+	if (inout_builder->Options.StableLayout)
+	{
+		if (inout_builder->PreviousFilesAddress > 0)
+		{
+			if (inout_builder->PreviousFilesAddress > inout_builder->ROMFilesAddress)
+				inout_builder->ROMFilesAddress = inout_builder->PreviousFilesAddress;
+		}
+		else
+		{
+			inout_builder->ROMFilesAddress = 0;
+			for (i = 0; i < LOADER_VARIANT_COUNT; i++)
+			{
+				if (*l_loader_variants[i].Length > inout_builder->ROMFilesAddress)
+					inout_builder->ROMFilesAddress = *l_loader_variants[i].Length;
+			}
+
+			inout_builder->ROMFilesAddress += sizeof(ROMFileInfo) * (inout_builder->FileInfoCount + STABLE_SPARE_DIRECTORY_ENTRIES);
+		}
+	}
+
+	inout_builder->ROMImageAddress = inout_builder->ROMFilesAddress;
+
+	return CreateROMFileSystem(inout_builder);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Changes the storage mode of the files which saves the required number of bytes
+// with the minimum increase of the load time (starting from the base modes).
+// out_saved is false if the saving can't be reached. Returns false if there is not enough memory.
+static bool SelectFilesToCompress(KiloCartBuilder* inout_builder, StorageMode* in_base_modes, int in_required_saving, bool* out_saved)
+{
+	long long* cost;
+	uint8_t* selected;
+	int saving[MAX_FILE_NUMBER][STORAGE_MODE_COUNT];
+	long long time_increase[MAX_FILE_NUMBER][STORAGE_MODE_COUNT];
+	long long weight;
+	StorageMode mode;
+	int i, j, k;
+	int previous;
+
+	// determine saving and load time increase of the other storage modes of the files
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		// autostart file (its first instance can be in the 1.x directory)
+		weight = 1;
+		for (j = i; j < inout_builder->FileInfoCount; j++)
+		{
+			if (FindFirstFileInstance(inout_builder, j) == i && IsAutostartFile(inout_builder, j))
+			{
+				weight = AUTOSTART_LOAD_TIME_WEIGHT;
+				break;
+			}
+		}
+
+		for (mode = STORAGE_RAW; mode < STORAGE_MODE_COUNT; mode++)
+		{
+			saving[i][mode] = 0;
+			time_increase[i][mode] = 0;
+
+			if (inout_builder->FileInfo[i].StoredData[mode] != NULL && mode != in_base_modes[i] && FindFirstFileInstance(inout_builder, i) == i && !inout_builder->Options.ForceCompression)
+			{
+				saving[i][mode] = GetStoredLength(&inout_builder->FileInfo[i], in_base_modes[i]) - GetStoredLength(&inout_builder->FileInfo[i], mode);
+				time_increase[i][mode] = (EstimateLoadTime(inout_builder, &inout_builder->FileInfo[i], mode) - EstimateLoadTime(inout_builder, &inout_builder->FileInfo[i], in_base_modes[i])) * weight;
+			}
+		}
+	}
+
+	// multiple-choice knapsack: cost[k] is the minimum time increase which saves at least k bytes,
+	// selected is the storage mode chosen for the file at the given saving (+1, 0 if the mode is not changed)
+	cost = (long long*)malloc((in_required_saving + 1) * sizeof(long long));
+	selected = (uint8_t*)calloc((size_t)inout_builder->FileInfoCount * (in_required_saving + 1), sizeof(uint8_t));
+	if (cost == NULL || selected == NULL)
+	{
+		free(selected);
+		free(cost);
+		return false;
+	}
+
+	cost[0] = 0;
+	for (k = 1; k <= in_required_saving; k++)
+		cost[k] = LLONG_MAX;
+
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+	{
+		for (k = in_required_saving; k > 0; k--)
+		{
+			for (mode = STORAGE_RAW; mode < STORAGE_MODE_COUNT; mode++)
+			{
+				if (saving[i][mode] <= 0)
+					continue;
+
+				previous = (k > saving[i][mode]) ? k - saving[i][mode] : 0;
+				if (cost[previous] != LLONG_MAX && cost[previous] + time_increase[i][mode] < cost[k])
+				{
+					cost[k] = cost[previous] + time_increase[i][mode];
+					selected[i * (in_required_saving + 1) + k] = (uint8_t)(mode + 1);
+				}
+			}
+		}
+	}
+
+	*out_saved = (cost[in_required_saving] != LLONG_MAX);
+
+	// change the storage mode of the selected files
+	for (i = 0; i < inout_builder->FileInfoCount; i++)
+		inout_builder->FileInfo[i].Mode = in_base_modes[i];
+
+	if (*out_saved)
+	{
+		k = in_required_saving;
+		for (i = inout_builder->FileInfoCount - 1; i >= 0 && k > 0; i--)
+		{
+			if (selected[i * (in_required_saving + 1) + k] != 0)
+			{
+				mode = (StorageMode)(selected[i * (in_required_saving + 1) + k] - 1);
+				inout_builder->FileInfo[i].Mode = mode;
+				k = (k > saving[i][mode]) ? k - saving[i][mode] : 0;
+			}
+		}
+	}
+
+	free(selected);
+	free(cost);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the number of bytes the file uses in the given storage mode
+static int GetStoredLength(ProgramFileInfo* in_file_info, StorageMode in_mode)
+{
+	return in_file_info->StoredLength[in_mode];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Estimates load time of the file in the given storage mode (in T-states) by replaying
+// the loader copy routine at the current ROM address of the file
+static long long EstimateLoadTime(KiloCartBuilder* in_builder, ProgramFileInfo* in_file_info, StorageMode in_mode)
+{
+	long long t_states;
+
+	switch (in_mode)
+	{
+		case STORAGE_ZX7:
+			t_states = EstimateDecompressionTime(in_file_info->StoredData[STORAGE_ZX7], in_file_info->StoredLength[STORAGE_ZX7], in_file_info->ROMAddress, in_builder->OffsetBits);
+			break;
+
+		case STORAGE_LZB:
+			t_states = EstimateLZBDecompressionTime(in_file_info->StoredData[STORAGE_LZB], in_file_info->StoredLength[STORAGE_LZB], in_file_info->ROMAddress);
+			break;
+
+		default:
+			t_states = EstimateRawCopyTime(in_file_info->ROMAddress, in_file_info->Length);
+			break;
+	}
+
+	// the loader restores the filtered file after it is copied
+	if ((in_file_info->Filters[in_mode] & ROM_FILE_FLAG_CODE_FILTER) != 0)
+		t_states += EstimateCodeFilterTime(in_file_info->StoredData[STORAGE_RAW], in_file_info->Length);
+
+	if ((in_file_info->Filters[in_mode] & ROM_FILE_FLAG_ROW_DELTA) != 0)
+		t_states += EstimateRowDeltaTime(in_file_info->Length);
+
+	return t_states;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true if there is a loader variant with the LZB decompressor for the selected
+// options (it is not part of the stream and background loading variants)
+static bool IsLZBAvailable(KiloCartBuilder* in_builder)
+{
+	unsigned int features = LOADER_FEATURE_LZB;
+	int i;
+
+	if (in_builder->Options.AsyncMode)
+		features |= LOADER_FEATURE_ASYNC;
+
+	for (i = 0; i < in_builder->FileInfoCount; i++)
+	{
+		if (in_builder->FileInfo[i].StreamFile)
+			features |= LOADER_FEATURE_DECOMPRESSOR | LOADER_FEATURE_STREAM;
+	}
+
+	for (i = 0; i < LOADER_VARIANT_COUNT; i++)
+	{
+		if ((l_loader_variants[i].Features & features) == features)
+			return true;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true if there is a loader variant with the inverse filters for the selected
+// options (it is not part of the background loading variants)
+static bool IsFilterAvailable(KiloCartBuilder* in_builder)
+{
+	unsigned int features = LOADER_FEATURE_FILTER;
+	int i;
+
+	if (in_builder->Options.AsyncMode)
+		features |= LOADER_FEATURE_ASYNC;
+
+	for (i = 0; i < LOADER_VARIANT_COUNT; i++)
+	{
+		if ((l_loader_variants[i].Features & features) == features)
+			return true;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Copies the compressed content of the file from the cache of the watch mode.
+// Returns false if the file (with the same content and options) is not in the cache
+// or its content can't be copied (the file is compressed again).
+static bool LoadFromCompressedCache(KiloCartBuilder* inout_builder, ProgramFileInfo* inout_file_info, bool in_lzb_available, bool in_filter_available)
+{
+	CompressedFileCacheEntry* entry;
+	wchar_t buffer[MAX_PATH_LENGTH];
+	uint32_t crc;
+	StorageMode mode;
+	StorageMode copied_mode;
+	int i;
+
+	crc = KiloCartCalculateCRC32(inout_file_info->StoredData[STORAGE_RAW], inout_file_info->Length);
+
+	for (i = 0; i < inout_builder->CompressedCacheCount; i++)
+	{
+		entry = &inout_builder->CompressedCache[i];
+
+		if (entry->CRC == crc && entry->Length == inout_file_info->Length && entry->StreamFile == inout_file_info->StreamFile &&
+			entry->FilterOptions == inout_file_info->FilterOptions && IsMatchingCacheEntry(inout_builder, entry, in_lzb_available, in_filter_available))
+		{
+			for (mode = STORAGE_ZX7; mode < STORAGE_MODE_COUNT; mode++)
+			{
+				inout_file_info->StoredData[mode] = NULL;
+				if (entry->StoredData[mode] != NULL)
+				{
+					inout_file_info->StoredData[mode] = (uint8_t*)malloc(entry->StoredLength[mode]);
+					if (inout_file_info->StoredData[mode] == NULL)
+					{
+						for (copied_mode = STORAGE_ZX7; copied_mode < mode; copied_mode++)
+						{
+							free(inout_file_info->StoredData[copied_mode]);
+							inout_file_info->StoredData[copied_mode] = NULL;
+						}
+
+						return false;
+					}
+					memcpy(inout_file_info->StoredData[mode], entry->StoredData[mode], entry->StoredLength[mode]);
+				}
+
+				inout_file_info->StoredLength[mode] = entry->StoredLength[mode];
+				inout_file_info->Filters[mode] = entry->Filters[mode];
+			}
+
+			entry->Used = true;
+
+			GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, inout_file_info->Filename);
+			PRINT_INFO(inout_builder, L"\nUnchanged file: %s (compressed data is reused)", buffer);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stores a copy of the compressed content of the file in the cache of the watch mode
+// (the file is not cached if there is not enough memory)
+static void StoreInCompressedCache(KiloCartBuilder* inout_builder, ProgramFileInfo* in_file_info, bool in_lzb_available, bool in_filter_available)
+{
+	CompressedFileCacheEntry* entry;
+	StorageMode mode;
+	StorageMode copied_mode;
+
+	if (inout_builder->CompressedCacheCount >= MAX_CACHE_ENTRY_COUNT)
+		return;
+
+	entry = &inout_builder->CompressedCache[inout_builder->CompressedCacheCount];
+
+	entry->CRC = KiloCartCalculateCRC32(in_file_info->StoredData[STORAGE_RAW], in_file_info->Length);
+	entry->Length = in_file_info->Length;
+	entry->StreamFile = in_file_info->StreamFile;
+	entry->FilterOptions = in_file_info->FilterOptions;
+	entry->OffsetBits = inout_builder->OffsetBits;
+	entry->CompressionLevel = inout_builder->Options.CompressionLevel;
+	entry->ForceCompression = inout_builder->Options.ForceCompression;
+	entry->SegmentedParse = inout_builder->Options.SegmentedParse;
+	entry->ThreadCount = inout_builder->Options.ThreadCount;
+	entry->LZBAvailable = in_lzb_available;
+	entry->FilterAvailable = in_filter_available;
+	entry->Used = true;
+
+	entry->StoredData[STORAGE_RAW] = NULL;
+	entry->StoredLength[STORAGE_RAW] = in_file_info->Length;
+	entry->Filters[STORAGE_RAW] = 0;
+
+	for (mode = STORAGE_ZX7; mode < STORAGE_MODE_COUNT; mode++)
+	{
+		entry->StoredData[mode] = NULL;
+		if (in_file_info->StoredData[mode] != NULL)
+		{
+			entry->StoredData[mode] = (uint8_t*)malloc(in_file_info->StoredLength[mode]);
+			if (entry->StoredData[mode] == NULL)
+			{
+				for (copied_mode = STORAGE_ZX7; copied_mode < mode; copied_mode++)
+					free(entry->StoredData[copied_mode]);
+
+				return;
+			}
+			memcpy(entry->StoredData[mode], in_file_info->StoredData[mode], in_file_info->StoredLength[mode]);
+		}
+
+		entry->StoredLength[mode] = in_file_info->StoredLength[mode];
+		entry->Filters[mode] = in_file_info->Filters[mode];
+	}
+
+	inout_builder->CompressedCacheCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Checks if the cache entry was created with the current compression options
+// (the options can be changed between the builds by KiloCartSetOptions)
+static bool IsMatchingCacheEntry(KiloCartBuilder* in_builder, CompressedFileCacheEntry* in_entry, bool in_lzb_available, bool in_filter_available)
+{
+	if (in_entry->OffsetBits != in_builder->OffsetBits || in_entry->CompressionLevel != in_builder->Options.CompressionLevel ||
+		in_entry->ForceCompression != in_builder->Options.ForceCompression || in_entry->SegmentedParse != in_builder->Options.SegmentedParse)
+		return false;
+
+	if (in_entry->SegmentedParse && in_entry->ThreadCount != in_builder->Options.ThreadCount)
+		return false;
+
+	return in_entry->LZBAvailable == in_lzb_available && in_entry->FilterAvailable == in_filter_available;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases the cache entries which were not used by the last build (or all entries)
+static void ReleaseCompressedCache(KiloCartBuilder* inout_builder, bool in_release_all)
+{
+	StorageMode mode;
+	int count = 0;
+	int i;
+
+	for (i = 0; i < inout_builder->CompressedCacheCount; i++)
+	{
+		if (inout_builder->CompressedCache[i].Used && !in_release_all)
+		{
+			inout_builder->CompressedCache[i].Used = false;
+			inout_builder->CompressedCache[count++] = inout_builder->CompressedCache[i];
+		}
+		else
+		{
+			for (mode = STORAGE_ZX7; mode < STORAGE_MODE_COUNT; mode++)
+				free(inout_builder->CompressedCache[i].StoredData[mode]);
+		}
+	}
+
+	inout_builder->CompressedCacheCount = count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays the bit accounting, the match finder statistics and the heat map of
+// the ZX7 compressed files (returns false if there is not enough memory)
+static bool PrintCompressionStats(KiloCartBuilder* in_builder)
+{
+	ZX7Stats* stats;
+	wchar_t buffer[MAX_PATH_LENGTH];
+	uint8_t* data;
+	size_t total_bits;
+	size_t count;
+	int region_bytes;
+	int i;
+	int k;
+
+	stats = (ZX7Stats*)malloc(sizeof(ZX7Stats));
+	if (stats == NULL)
+	{
+		PRINT_ERROR(in_builder, L"\nInsufficient memory!");
+		return false;
+	}
+
+	for (i = 0; i < in_builder->FileInfoCount; i++)
+	{
+		if (in_builder->FileInfo[i].StoredData[STORAGE_ZX7] == NULL)
+			continue;
+
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_builder->FileInfo[i].Filename);
+
+		if (!ZX7CollectStats(in_builder->FileInfo[i].StoredData[STORAGE_ZX7], in_builder->FileInfo[i].StoredLength[STORAGE_ZX7], in_builder->OffsetBits, stats))
+		{
+			PRINT_ERROR(in_builder, L"\nInvalid compressed data: %s", buffer);
+			continue;
+		}
+
+		// the match finder runs on the compressed (filtered) content
+		if (in_builder->FileInfo[i].Filters[STORAGE_ZX7] != 0)
+			data = CreateFilteredData(&in_builder->FileInfo[i], in_builder->FileInfo[i].Filters[STORAGE_ZX7]);
+		else
+			data = in_builder->FileInfo[i].StoredData[STORAGE_RAW];
+
+		if (data == NULL || !ZX7CollectMatchFinderStats(data, in_builder->FileInfo[i].Length, GetZX7MaxOffset(in_builder, &in_builder->FileInfo[i]), stats))
+		{
+			if (data != in_builder->FileInfo[i].StoredData[STORAGE_RAW])
+				free(data);
+
+			free(stats);
+			PRINT_ERROR(in_builder, L"\nInsufficient memory!");
+			return false;
+		}
+
+		if (data != in_builder->FileInfo[i].StoredData[STORAGE_RAW])
+			free(data);
+
+		total_bits = stats->CompressedLength * 8;
+
+		PRINT_INFO(in_builder, L"\n\nZX7 statistics: %s (%d -> %d bytes)", buffer, (int)stats->InputLength, (int)stats->CompressedLength);
+		PRINT_INFO(in_builder, L"\n  Pre-screen estimate: order-0 %.2f, order-1 %.2f bits/byte, %.1f%% digram hits", in_builder->FileInfo[i].Compressibility.Order0Entropy,
+			in_builder->FileInfo[i].Compressibility.Order1Entropy, in_builder->FileInfo[i].Compressibility.DigramHitRate * 100);
+		PRINT_INFO(in_builder, L"\n  Literals: %d, %d bits (%d%%)", (int)stats->LiteralCount, (int)stats->LiteralBits, (int)(stats->LiteralBits * 100 / total_bits));
+		PRINT_INFO(in_builder, L"\n  Literal/sequence flags: %d bits (%d%%)", (int)stats->FlagBits, (int)(stats->FlagBits * 100 / total_bits));
+		PRINT_INFO(in_builder, L"\n  Sequences: %d, Elias-gamma lengths %d bits (%d%%)", (int)stats->SequenceCount, (int)stats->LengthBits, (int)(stats->LengthBits * 100 / total_bits));
+		PRINT_INFO(in_builder, L"\n  Short offsets: %d, %d bits (%d%%)", (int)stats->ShortOffsetCount, (int)stats->ShortOffsetBits, (int)(stats->ShortOffsetBits * 100 / total_bits));
+		PRINT_INFO(in_builder, L"\n  Long offsets: %d, %d bits (%d%%)", (int)stats->LongOffsetCount, (int)stats->LongOffsetBits, (int)(stats->LongOffsetBits * 100 / total_bits));
+		PRINT_INFO(in_builder, L"\n  End marker and padding: %d bits", (int)(total_bits - stats->LiteralBits - stats->FlagBits - stats->LengthBits - stats->ShortOffsetBits - stats->LongOffsetBits));
+
+		// histograms (class k contains the lengths 2^k+1..2^(k+1) and the offsets 2^k..2^(k+1)-1)
+		PRINT_INFO(in_builder, L"\n  Sequence lengths:");
+		for (k = 0; k < ZX7_STATS_LENGTH_CLASS_COUNT; k++)
+		{
+			count = stats->LengthHistogram[k];
+			if (count == 0)
+				continue;
+
+			if (k == 0)
+				PRINT_INFO(in_builder, L" 2: %d", (int)count);
+			else
+				PRINT_INFO(in_builder, L" %d-%d: %d", (1 << k) + 1, 2 << k, (int)count);
+		}
+
+		PRINT_INFO(in_builder, L"\n  Offsets:");
+		for (k = 0; k < ZX7_STATS_OFFSET_CLASS_COUNT; k++)
+		{
+			count = stats->OffsetHistogram[k];
+			if (count == 0)
+				continue;
+
+			if (k == 0)
+				PRINT_INFO(in_builder, L" 1: %d", (int)count);
+			else
+				PRINT_INFO(in_builder, L" %d-%d: %d", 1 << k, (2 << k) - 1, (int)count);
+		}
+
+		PRINT_INFO(in_builder, L"\n  Match finder: %llu chain steps, %llu length extension steps (%d and %d per input byte)",
+			(unsigned long long)stats->ChainSteps, (unsigned long long)stats->ExtensionSteps,
+			(int)(stats->ChainSteps / in_builder->FileInfo[i].Length), (int)(stats->ExtensionSteps / in_builder->FileInfo[i].Length));
+
+		// heat map
+		PRINT_INFO(in_builder, L"\n  Heat map (compressed bytes per %d input bytes):", ZX7_STATS_REGION_SIZE);
+		for (k = 0; k < stats->RegionCount; k++)
+		{
+			if (k % 16 == 0)
+				PRINT_INFO(in_builder, L"\n    0x%04X:", k * ZX7_STATS_REGION_SIZE);
+
+			region_bytes = (stats->RegionBits[k] + 7) / 8;
+			PRINT_INFO(in_builder, L" %3d%c", region_bytes, (region_bytes >= ZX7_STATS_REGION_SIZE) ? '*' : ' ');
+		}
+	}
+
+	free(stats);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the storage mode of a directory entry
+static StorageMode GetStorageModeFromFlags(int in_flags)
+{
+	if ((in_flags & ROM_FILE_FLAG_COMPRESSED) != 0)
+		return STORAGE_ZX7;
+
+	if ((in_flags & ROM_FILE_FLAG_LZB) != 0)
+		return STORAGE_LZB;
+
+	return STORAGE_RAW;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays the estimated load time of the files (copy from the cartridge into the RAM),
+// returns the total load time
+static long long PrintLoadTimes(KiloCartBuilder* in_builder)
+{
+	wchar_t buffer[MAX_PATH_LENGTH];
+	long long t_states;
+	long long total_t_states = 0;
+	int i;
+
+	PRINT_INFO(in_builder, L"\nEstimated load times:");
+
+	for (i = 0; i < in_builder->FileInfoCount; i++)
+	{
+		// duplicated files are listed once, execute-in-place files are not copied
+		if (FindFirstFileInstance(in_builder, i) != i || in_builder->FileInfo[i].XIPFile)
+			continue;
+
+		t_states = EstimateLoadTime(in_builder, &in_builder->FileInfo[i], in_builder->FileInfo[i].Mode);
+		total_t_states += t_states;
+
+		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, in_builder->FileInfo[i].Filename);
+		PRINT_INFO(in_builder, L"\n  %s: %s, %lld T-states (%d ms)", buffer, l_storage_mode_names[in_builder->FileInfo[i].Mode], t_states, TStatesToMilliseconds(t_states));
+	}
+
+	PRINT_INFO(in_builder, L"\n  Total: %lld T-states (%d ms)", total_t_states, TStatesToMilliseconds(total_t_states));
+
+	return total_t_states;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true if the file is the autostart file of the 1.x or 2.x directory
+static bool IsAutostartFile(KiloCartBuilder* in_builder, int in_index)
+{
+	return in_index == 0 || in_builder->FileInfo[in_index].Version2xFile != in_builder->FileInfo[in_index - 1].Version2xFile;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the index of the first file with the same name (the file content is stored only once)
+static int FindFirstFileInstance(KiloCartBuilder* in_builder, int in_index)
+{
+	int i;
+
+	for (i = 0; i < in_index; i++)
+	{
+		if (CompareFilenames(in_builder->FileInfo[in_index].Filename, in_builder->FileInfo[i].Filename) == 0)
+			return i;
+	}
+
+	return in_index;
+}
@@ -11,98 +11,84 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
-#include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
 #include <Windows.h>
-#include <CASFile.h>
 #include <FileUtils.h>
+#include "KiloCart.h"
 #include "ZX7Compress.h"
+#include "ZX7Stats.h"
+#include "Compressibility.h"
+#include "FileWatch.h"
+#include "Benchmark.h"
+#include "TapeWave.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Constants
-#define CART_ROM_SIZE 65536
-#define CART_PAGE_SIZE 16384
-#define FILE_BUFFER_SIZE 1024*1024
-#define MAX_FILE_NUMBER 64
-#define ROM_PAGE_CHANGE_ADDRESS 0x3ffc
+#define DEFAULT_SECTOR_SIZE 4096					// Erase sector size of the EPROM/flash (diff output)
 
 #define PRINT_ERROR(...) fwprintf (stderr, __VA_ARGS__)
 #define PRINT_INFO(...) fwprintf (stdout, __VA_ARGS__)
 
-///////////////////////////////////////////////////////////////////////////////
-// Loader binary data
-extern const long int kilocart_loader_bin_size;
-extern const unsigned char kilocart_loader_bin[];
-
-extern const long int kilocart_decomp_loader_bin_size;
-extern const unsigned char kilocart_decomp_loader_bin[];
-
-
 ///////////////////////////////////////////////////////////////////////////////
 // Types
-typedef struct 
-{
-	wchar_t Filename[MAX_PATH_LENGTH];
-	int BufferPos;
-	int ROMAddress;
-	int Length;
-	bool Version2xFile;
-} ProgramFileInfo;
-
-#pragma pack(push, 1)
-
-typedef struct
-{
-	char Filename[MAX_TVC_FILE_NAME_LENGTH];
-	uint16_t Address;
-	uint16_t Length;
-} ROMFileInfo;
 
+// Input file of the command line (it is loaded by every build)
 typedef struct
 {
-	uint8_t Files1xCount;	// Number of files in the image for 1.x TVC ROM version
-	uint8_t Files2xCount;	// Number of files in the image for 2.x TVC ROM version
-	uint16_t Directory1xAddress;	// Address of the directory for 1.x TVC ROM version
-	uint16_t Directory2xAddress;	// Address of the directory for 1.x TVC ROM version
-	uint16_t FilesAddress;				// Address of the file data
-} ROMFileSystemInfo;
-
-#pragma pack(pop)
+	wchar_t Filename[MAX_PATH_LENGTH];
+	KiloCartFileOptions Options;
+} InputFileInfo;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
-bool LoadFiles(void);
-bool LoadProgramFile(ProgramFileInfo* inout_cas_file);
-bool CreateROMImage(void);
-bool CreateROMLoader();
-bool CreateROMDirectory();
-bool CreateROMFileSystem();
+bool AddInputFile(wchar_t* in_file_name, KiloCartFileOptions* in_options);
+bool BuildImages(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name);
+bool WatchInputFiles(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name);
+bool RebuildImages(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name);
+bool CreateBenchmarkFiles(wchar_t* in_parameters);
+bool RunBenchmark(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name);
+bool DecodeTapeRecording(wchar_t* in_wave_file_name, int* out_file_count);
+bool LoadFiles(KiloCartBuilder* inout_builder);
+bool LoadProgramFile(KiloCartBuilder* inout_builder, InputFileInfo* in_input_file);
+bool SaveROMImage(wchar_t* in_file_name, uint8_t* in_image);
+bool CreateMultiCartridgeImages(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name);
+void GetCartridgeFileName(wchar_t* out_file_name, wchar_t* in_output_file_name, int in_cartridge_index, int in_cartridge_count);
+bool LoadROMImage(wchar_t* in_file_name, uint8_t* out_image);
+bool PrintImageDiff(uint8_t* in_image);
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables
 
-uint8_t g_page_start_bytes[] = { 'M', 'O', 'P', 'S', 0x3A, 0xFC, 0xFF };
-uint8_t g_page_end_bytes[] = { 0x00, 0x01, 0x02, 0x03 };
+InputFileInfo g_input_files[MAX_FILE_NUMBER];
+int g_input_file_count = 0;
 
+uint8_t g_rom_image[CART_ROM_SIZE];
 
-byte g_file_buffer[FILE_BUFFER_SIZE];
-int g_file_buffer_length;
+// stable layout and diff output
+wchar_t g_previous_image_file_name[MAX_PATH_LENGTH];
+wchar_t g_diff_image_file_name[MAX_PATH_LENGTH];
+int g_sector_size = DEFAULT_SECTOR_SIZE;
 
-byte g_rom_image[FILE_BUFFER_SIZE];
-int g_rom_image_address;
+// multi-cartridge mode
+bool g_multi_cartridge = false;
 
-ProgramFileInfo g_file_info[MAX_FILE_NUMBER];
-int g_file_info_count;
+// watch mode
+bool g_watch_mode = false;
+wchar_t g_pipe_name[MAX_PATH_LENGTH];
 
-bool g_compressed_mode = false;
+// benchmark
+wchar_t g_benchmark_directory[MAX_PATH_LENGTH];
+wchar_t g_benchmark_file_names[MAX_FILE_NUMBER][MAX_PATH_LENGTH];
+int g_benchmark_file_count = 0;
 
-int g_rom_file_system_info_address;
-int g_rom_files_address;
+// tape recordings
+wchar_t g_tape_file_names[MAX_FILE_NUMBER][MAX_PATH_LENGTH];
+int g_tape_file_count = 0;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -111,17 +97,31 @@ int wmain(int argc, wchar_t** argv)
 {
 	int i;
 	bool success = true;
-	int file_index = 0;
-	bool version_2x_enabled = false;
+	KiloCartBuilder* builder = NULL;
+	KiloCartOptions options;
+	KiloCartFileOptions file_options;
+	KiloCartFileOptions generated_file_options;
+	int j;
+	int tape_file_count;
+	wchar_t* address_end;
+	wchar_t* option;
 	wchar_t output_file_name[MAX_PATH_LENGTH];
-	FILE* output_file = NULL;
 
 	// intro
 	PRINT_INFO(L"\nROM Image Builder for 64k TV Computer Cartridge v0.1");
 	PRINT_INFO(L"\n(c) 2021 Laszlo Arvai");
 
+	// messages of the builder are displayed on the console
+	KiloCartGetDefaultOptions(&options);
+	options.Verbose = true;
+
+	KiloCartGetDefaultFileOptions(&file_options);
+
 	// default output file name
 	wcscpy_s(output_file_name, MAX_PATH_LENGTH, L"KiloCart.bin");
+	g_previous_image_file_name[0] = '\0';
+	g_diff_image_file_name[0] = '\0';
+	g_pipe_name[0] = '\0';
 
 	i = 1;
 	while (i < argc && success)
@@ -132,7 +132,7 @@ int wmain(int argc, wchar_t** argv)
 			switch (tolower(argv[i][1]))
 			{
 			case '2':
-				version_2x_enabled = true;
+				file_options.Version2xFile = true;
 				break;
 
 				// output file name
@@ -140,6 +140,7 @@ int wmain(int argc, wchar_t** argv)
 				if (i + 1 < argc)
 				{
 					wcscpy_s(output_file_name, MAX_PATH_LENGTH, argv[i + 1]);
+					i++;
 				}
 				else
 				{
@@ -150,7 +151,242 @@ int wmain(int argc, wchar_t** argv)
 
 			// force compressed mode
 			case 'c':
-				g_compressed_mode = true;
+				options.ForceCompression = true;
+				break;
+
+			// fast compression level
+			case '1':
+				options.CompressionLevel = COMPRESSION_LEVEL_FAST;
+				break;
+
+			// best compression level
+			case '9':
+				options.CompressionLevel = COMPRESSION_LEVEL_BEST;
+				break;
+
+			// stream mode for the following files
+			case 's':
+				file_options.StreamFile = true;
+				break;
+
+			// multi-cartridge mode
+			case 'm':
+				g_multi_cartridge = true;
+				break;
+
+			// the following files are stored on the same cartridge
+			case 'g':
+				file_options.Group++;
+				break;
+
+			// background loading
+			case 'a':
+				options.AsyncMode = true;
+				break;
+
+			// parallel segmented parse
+			case 'p':
+				options.SegmentedParse = true;
+				break;
+
+			// compare segmented parse with the exact parse
+			case 'e':
+				options.SegmentedParse = true;
+				options.CompareExactParse = true;
+				break;
+
+			// execute-in-place mode for the following files
+			case 'x':
+				file_options.XIPFile = true;
+				break;
+
+			// code filter for the following files
+			case 'f':
+				file_options.FilterOptions |= ROM_FILE_FLAG_CODE_FILTER;
+				break;
+
+			// row delta filter for the following files
+			case 'b':
+				file_options.FilterOptions |= ROM_FILE_FLAG_ROW_DELTA;
+				break;
+
+			// video memory load mode for the following files
+			case 'v':
+				file_options.VideoFile = true;
+				break;
+
+			// native machine code autostart file (load and entry address of the next file)
+			case 'n':
+				if (i + 1 < argc)
+				{
+					file_options.LoadAddress = (int)wcstol(argv[i + 1], &address_end, 0);
+					file_options.EntryAddress = file_options.LoadAddress;
+					if (*address_end == ',')
+						file_options.EntryAddress = (int)wcstol(address_end + 1, &address_end, 0);
+
+					if (*address_end != '\0' || file_options.LoadAddress < 0 || file_options.LoadAddress > 0xffff || file_options.EntryAddress < 0 || file_options.EntryAddress > 0xffff)
+					{
+						PRINT_ERROR(L"\nInvalid parameter for option 'n'.");
+						success = false;
+					}
+
+					file_options.NativeFile = true;
+					i++;
+				}
+				else
+				{
+					PRINT_ERROR(L"\nNo parameter for option 'n'.");
+					success = false;
+				}
+				break;
+
+			// long options
+			case '-':
+				option = argv[i] + 2;
+				if (_wcsicmp(option, L"watch") == 0)
+				{
+					// rebuild the image when the input files are changed
+					g_watch_mode = true;
+				}
+				else if (_wcsicmp(option, L"stats") == 0)
+				{
+					// display compression statistics
+					options.PrintStats = true;
+				}
+				else if (_wcsicmp(option, L"no-prescreen") == 0)
+				{
+					// compress the incompressible files too
+					options.Prescreen = false;
+				}
+				else if (_wcsicmp(option, L"fit") == 0)
+				{
+					// drop the files with the lowest priority if the files don't fit
+					options.FitMode = true;
+				}
+				else if (_wcsicmp(option, L"stable") != 0 && _wcsicmp(option, L"slack") != 0 && _wcsicmp(option, L"diff") != 0 &&
+					_wcsicmp(option, L"sector") != 0 && _wcsicmp(option, L"pipe") != 0 && _wcsicmp(option, L"benchmark") != 0 &&
+					_wcsicmp(option, L"offset-bits") != 0 && _wcsicmp(option, L"decode-budget") != 0 && _wcsicmp(option, L"tape") != 0 &&
+					_wcsicmp(option, L"priority") != 0)
+				{
+					PRINT_ERROR(L"\nUnknown option '%s'.", argv[i]);
+					success = false;
+				}
+				else if (i + 1 >= argc)
+				{
+					PRINT_ERROR(L"\nNo parameter for option '%s'.", argv[i]);
+					success = false;
+				}
+				else
+				{
+					i++;
+
+					// keep file placements of the previous image
+					if (_wcsicmp(option, L"stable") == 0)
+					{
+						wcscpy_s(g_previous_image_file_name, MAX_PATH_LENGTH, argv[i]);
+						options.StableLayout = true;
+					}
+
+					// stable layout with the given page slack
+					if (_wcsicmp(option, L"slack") == 0)
+					{
+						options.PageSlack = (int)wcstol(argv[i], &address_end, 0);
+						if (*address_end != '\0' || options.PageSlack < 0 || options.PageSlack > ROM_PAGE_CHANGE_ADDRESS - ROM_PAGE_START_LENGTH)
+						{
+							PRINT_ERROR(L"\nInvalid parameter for option '--slack'.");
+							success = false;
+						}
+						options.StableLayout = true;
+					}
+
+					// compare with the previous image
+					if (_wcsicmp(option, L"diff") == 0)
+						wcscpy_s(g_diff_image_file_name, MAX_PATH_LENGTH, argv[i]);
+
+					// erase sector size of the diff output
+					if (_wcsicmp(option, L"sector") == 0)
+					{
+						g_sector_size = (int)wcstol(argv[i], &address_end, 0);
+						if (*address_end != '\0' || g_sector_size <= 0 || CART_ROM_SIZE % g_sector_size != 0)
+						{
+							PRINT_ERROR(L"\nInvalid parameter for option '--sector'.");
+							success = false;
+						}
+					}
+
+					// watch mode with build requests on a named pipe
+					if (_wcsicmp(option, L"pipe") == 0)
+					{
+						wcscpy_s(g_pipe_name, MAX_PATH_LENGTH, argv[i]);
+						g_watch_mode = true;
+					}
+
+					// long offset width of the ZX7 format
+					if (_wcsicmp(option, L"offset-bits") == 0)
+					{
+						if (_wcsicmp(argv[i], L"auto") == 0)
+						{
+							options.SearchOffsetBits = true;
+						}
+						else
+						{
+							options.OffsetBits = (int)wcstol(argv[i], &address_end, 0);
+							if (*address_end != '\0' || options.OffsetBits < MIN_OFFSET_BITS || options.OffsetBits > MAX_OFFSET_BITS)
+							{
+								PRINT_ERROR(L"\nInvalid parameter for option '--offset-bits'.");
+								success = false;
+							}
+						}
+					}
+
+					// decompression time limit of the format search
+					if (_wcsicmp(option, L"decode-budget") == 0)
+					{
+						options.DecodeBudget = (int)wcstol(argv[i], &address_end, 0);
+						if (*address_end != '\0' || options.DecodeBudget < 0)
+						{
+							PRINT_ERROR(L"\nInvalid parameter for option '--decode-budget'.");
+							success = false;
+						}
+						options.SearchOffsetBits = true;
+					}
+
+					// priority of the following files in fit mode
+					if (_wcsicmp(option, L"priority") == 0)
+					{
+						file_options.Priority = (int)wcstol(argv[i], &address_end, 0);
+						if (*address_end != '\0' || file_options.Priority < 0 || file_options.Priority > MAX_FILE_PRIORITY)
+						{
+							PRINT_ERROR(L"\nInvalid parameter for option '--priority'.");
+							success = false;
+						}
+						options.FitMode = true;
+					}
+
+					// decoded and synthetic files are never native autostart files
+					generated_file_options = file_options;
+					generated_file_options.NativeFile = false;
+					generated_file_options.LoadAddress = 0;
+					generated_file_options.EntryAddress = 0;
+
+					// files of a tape recording, they are handled as they were specified here
+					if (_wcsicmp(option, L"tape") == 0)
+					{
+						success = DecodeTapeRecording(argv[i], &tape_file_count);
+
+						for (j = g_tape_file_count - tape_file_count; j < g_tape_file_count && success; j++)
+							success = AddInputFile(g_tape_file_names[j], &generated_file_options);
+					}
+
+					// synthetic input files, they are handled as they were specified here
+					if (_wcsicmp(option, L"benchmark") == 0)
+					{
+						success = CreateBenchmarkFiles(argv[i]);
+
+						for (j = 0; j < g_benchmark_file_count && success; j++)
+							success = AddInputFile(g_benchmark_file_names[j], &generated_file_options);
+					}
+				}
 				break;
 
 			case 'h':
@@ -167,9 +403,91 @@ int wmain(int argc, wchar_t** argv)
 				PRINT_INFO(L"     If same file name is intended to be used for both file system then it is recommended\n");
 				PRINT_INFO(L"     to put them into separated folder and specifiy their path in the filename.\n");
 				PRINT_INFO(L"     The path will not be stored in the ROM image.\n");
+				PRINT_INFO(L"     A file specified for both file systems is stored once, its '-s', '-x', '-f' and '-b' options must match.\n");
 				PRINT_INFO(L" -c: Forces to compressed ROM image. The data content will be compressed by ZX7 compressor\n");
 				PRINT_INFO(L"     and will be decompressed on the fly when the file is loaded. If compression if not forced\n");
-				PRINT_INFO(L"     the image builder will switch only to comressed mode when the specified files can't fit to the ROM.\n");
+				PRINT_INFO(L"     the storage mode is selected per file: files are stored in their fastest loading mode (usually\n");
+				PRINT_INFO(L"     compressed by the byte-aligned LZB codec which is decompressed by LDIR) and only those files are\n");
+				PRINT_INFO(L"     compressed by ZX7 which are required to fit into the ROM with the shortest load time.\n");
+				PRINT_INFO(L"     LZB is not used in the images which contain files after '-s' or use background loading.\n");
+				PRINT_INFO(L" -1: Fast compression level for the development builds. Files are compressed by lazy matching\n");
+				PRINT_INFO(L"     which is much faster than the optimal parse but the compressed files are longer.\n");
+				PRINT_INFO(L" -9: Best compression level. The exact optimal parse is used (even if '-p' is specified) and the\n");
+				PRINT_INFO(L"     fastest decompressing parse is selected from the equal size ones.\n");
+				PRINT_INFO(L"     The compressed data format (and the loader) is the same on all levels.\n");
+				PRINT_INFO(L" -s: Files specified after this option will be compressed using a small (%d bytes) window in compressed\n", STREAM_WINDOW_SIZE);
+				PRINT_INFO(L"     mode. These files can be read in chunks (by CH_IN or several BKIN calls) not only at once.\n");
+				PRINT_INFO(L" -a: Enables background loading. Programs can start a block input (function code 0xDC) which will be\n");
+				PRINT_INFO(L"     loaded in the video interrupt and check its status (function code 0xDD or byte at 0x0E80).\n");
+				PRINT_INFO(L"     In compressed mode only the files specified after '-s' can be loaded in the background.\n");
+				PRINT_INFO(L" -p: Compresses large files by parsing their segments in parallel (one segment per processor core).\n");
+				PRINT_INFO(L"     The result can be slightly longer than the exact parse.\n");
+				PRINT_INFO(L" -e: Same as '-p' but also runs the exact parse and reports the size difference.\n");
+				PRINT_INFO(L" -x: Files specified after this option are machine code files executed in place. They are stored\n");
+				PRINT_INFO(L"     uncompressed at the start of a ROM page and must be assembled to address 0x%04X.\n", CART_START_ADDRESS + ROM_PAGE_START_LENGTH);
+				PRINT_INFO(L"     Programs can open the file and call it by function code 0xDE (BC and DE are passed to the routine).\n");
+				PRINT_INFO(L" -v: Files specified after this option are loaded with the video memory paged into 0x8000-0xBFFF\n");
+				PRINT_INFO(L"     (screen files can be loaded directly to the video memory). Any opened file can be switched to\n");
+				PRINT_INFO(L"     this mode by function code 0xDF. The stack of the loading program must be outside of this area.\n");
+				PRINT_INFO(L" -f: Files specified after this option contain Z80 machine code. The absolute operands of CALL, JP\n");
+				PRINT_INFO(L"     and LD HL,nn are converted to position relative values before compression and restored by the\n");
+				PRINT_INFO(L"     loader. The filter is kept only for those storage modes where it makes the file shorter (not used\n");
+				PRINT_INFO(L"     for the files after '-s' and with background loading).\n");
+				PRINT_INFO(L" -b: Files specified after this option contain bitmap data in the video memory layout (screens, sprites\n");
+				PRINT_INFO(L"     with 64 bytes rows). Every byte is XORed by the byte of the previous row before compression and\n");
+				PRINT_INFO(L"     restored by the loader, vertically repeated pixels become short matches. Kept in the same way as '-f'.\n");
+				PRINT_INFO(L" -n: The next file is a native machine code autostart file. It is copied to the load address and\n");
+				PRINT_INFO(L"     started at the entry address without BASIC initialization and RUN (with the system ROM paged in).\n");
+				PRINT_INFO(L"     example: '-n 0x1000,0x1200 game.bin' (entry address is the load address if it is not specified)\n");
+				PRINT_INFO(L" -m: Multi-cartridge mode. If the files don't fit into one image they are distributed to as many\n");
+				PRINT_INFO(L"     images as required ('-o' name with '_1', '_2', ... suffix). The autostart files are stored on every\n");
+				PRINT_INFO(L"     cartridge, the other files are distributed with balanced fill. A catalog (output name with .txt\n");
+				PRINT_INFO(L"     extension) lists the content of the cartridges.\n");
+				PRINT_INFO(L" -g: Files specified after this option (until the next '-g') are loaded together, in multi-cartridge\n");
+				PRINT_INFO(L"     mode they are stored on the same cartridge.\n");
+				PRINT_INFO(L"     example: KiloCartImageBuilder.exe -m menu.cas -g game1.cas level1.cas -g game2.cas level2.cas\n");
+				PRINT_INFO(L" --fit: If the files don't fit into the cartridge, the files with the lowest total priority are left out.\n");
+				PRINT_INFO(L"     The selection uses the shortest stored length of the files, the autostart files are always kept and\n");
+				PRINT_INFO(L"     the files of a '-g' group are kept or dropped together. The dropped files are listed.\n");
+				PRINT_INFO(L" --priority value: Priority of the files specified after this option in fit mode (0-%d, default: %d),\n", MAX_FILE_PRIORITY, DEFAULT_FILE_PRIORITY);
+				PRINT_INFO(L"     it also enables fit mode. From the selections with equal priority the one with the most files is used.\n");
+				PRINT_INFO(L"     example: '--fit menu.cas --priority 10 game1.cas --priority 3 demo1.cas demo2.cas'\n");
+				PRINT_INFO(L" --stable old.bin: Keeps the address of the files of a previously created image when they still fit\n");
+				PRINT_INFO(L"     there. Changed files which don't fit are moved into the free areas, therefore a change in a file\n");
+				PRINT_INFO(L"     doesn't move the other files.\n");
+				PRINT_INFO(L" --slack bytes: Stable layout which leaves the given number of bytes free at the end of every page\n");
+				PRINT_INFO(L"     for the growing files (default: %d bytes, used by '--stable' too).\n", DEFAULT_PAGE_SLACK);
+				PRINT_INFO(L" --diff old.bin: Lists the erase sectors which are different from the given image (with CRC32 of\n");
+				PRINT_INFO(L"     the old and new content). Only these sectors need to be reprogrammed.\n");
+				PRINT_INFO(L" --sector bytes: Erase sector size for '--diff' (default: %d bytes).\n", DEFAULT_SECTOR_SIZE);
+				PRINT_INFO(L" --offset-bits n|auto: Number of the extra bits of the long ZX7 offsets (%d-%d, default: %d, offsets up to\n", MIN_OFFSET_BITS, MAX_OFFSET_BITS, OFFSET_BITS);
+				PRINT_INFO(L"     %d bytes). Wider offsets find more matches in the large files but every long offset is longer.\n", MAX_OFFSET);
+				PRINT_INFO(L"     'auto' selects the width which gives the shortest compressed files, the decompressor of the\n");
+				PRINT_INFO(L"     loader is set to the selected width.\n");
+				PRINT_INFO(L" --decode-budget percent: Same as '--offset-bits auto' but only those widths can be selected whose\n");
+				PRINT_INFO(L"     estimated decompression time is at most the given percent longer than with the default width.\n");
+				PRINT_INFO(L" --stats: Displays the bit accounting of the ZX7 compressed files (literals, flags, lengths, offsets),\n");
+				PRINT_INFO(L"     sequence length and offset histograms, the work of the match finder and a heat map of the\n");
+				PRINT_INFO(L"     compressed bytes per %d input bytes (incompressible areas are shown by '*').\n", ZX7_STATS_REGION_SIZE);
+				PRINT_INFO(L" --no-prescreen: Compresses every file. By default the files which look incompressible (order-0 entropy\n");
+				PRINT_INFO(L"     at least %.1f bits/byte and at most %d%% of the digrams found in the window before them, e.g. packed\n", COMPRESSIBILITY_MIN_ENTROPY, (int)(COMPRESSIBILITY_MAX_DIGRAM_HITS * 100));
+				PRINT_INFO(L"     or sampled data) are stored raw without compression, even with '-c'. Files with filters are not checked.\n");
+				PRINT_INFO(L" --watch: Keeps running after the image is created and rebuilds it when an input file is changed.\n");
+				PRINT_INFO(L"     The compressed data of the unchanged files is kept in the memory, only the changed files are\n");
+				PRINT_INFO(L"     compressed again.\n");
+				PRINT_INFO(L" --pipe name: Watch mode which also accepts build requests on the '\\\\.\\pipe\\name' named pipe. The client\n");
+				PRINT_INFO(L"     sends a 'build' line and receives 'ok' or 'error' when the image is up to date ('exit' stops the\n");
+				PRINT_INFO(L"     builder).\n");
+				PRINT_INFO(L" --tape recording.wav: Decodes the files of a TVC tape recording (8 or 16 bit PCM wave file) and adds\n");
+				PRINT_INFO(L"     them to the input files at the position of the option. The CAS files are saved into a folder named\n");
+				PRINT_INFO(L"     after the recording ('tapes\\side_a.wav' -> 'tapes\\side_a\\NAME.CAS'), damaged files are reported\n");
+				PRINT_INFO(L"     and skipped. The option can be used several times.\n");
+				PRINT_INFO(L" --benchmark count,length[,types]: Adds synthetic CAS files to the input files (at the position of the\n");
+				PRINT_INFO(L"     option) and displays the time and memory usage of the build phases (load, compress, layout, write).\n");
+				PRINT_INFO(L"     The length of the files varies between the half and one and a half times of the given length, the\n");
+				PRINT_INFO(L"     content types are used in turn: 'c' - machine code, 's' - screen, 'r' - random (default: 'csr').\n");
+				PRINT_INFO(L"     The content is repeatable, the files are created in the temporary folder and deleted after the build.\n");
+				PRINT_INFO(L"     example: '-c --benchmark 200,2048,cr' (image with 200 compressed files)\n");
 				success = false;
 				break;
 			}
@@ -177,379 +495,562 @@ int wmain(int argc, wchar_t** argv)
 		else
 		{
 			// filename found
-			wcsncpy_s(g_file_info[g_file_info_count].Filename, MAX_PATH_LENGTH, argv[i], MAX_PATH_LENGTH);
-			g_file_info[g_file_info_count].Version2xFile = version_2x_enabled;
-			g_file_info_count++;
+			success = AddInputFile(argv[i], &file_options);
+
+			file_options.NativeFile = false;
 		}
 
 		i++;
 	}
 
-	// Loads CAS files
-	if (success)
+	// multi-cartridge images can't be compared to a previous image
+	if (success && g_multi_cartridge && (options.StableLayout || g_diff_image_file_name[0] != '\0'))
 	{
-		g_file_buffer_length = 0;
-		success = LoadFiles();
+		PRINT_ERROR(L"\nStable layout and diff output can't be used in multi-cartridge mode.");
+		success = false;
 	}
 
-	// Creates ROM image
-	if (success)
+	// cartridges of the multi-cartridge mode contain all files
+	if (success && g_multi_cartridge && options.FitMode)
+	{
+		PRINT_ERROR(L"\nFit mode can't be used in multi-cartridge mode.");
+		success = false;
+	}
+
+	// benchmark measures only one build
+	if (success && g_watch_mode && g_benchmark_file_count > 0)
 	{
-		success = CreateROMImage();
+		PRINT_ERROR(L"\nBenchmark can't be used in watch mode.");
+		success = false;
 	}
 
-	// saves ROM image
+	// compressed data of the unchanged files is kept between the builds of the watch mode
 	if (success)
 	{
-		if (_wfopen_s(&output_file, output_file_name, L"wb") == 0 && output_file != NULL)
+		options.CacheCompressedFiles = g_watch_mode;
+
+		builder = KiloCartCreate(&options);
+		if (builder == NULL)
 		{
-			fwrite(g_rom_image, CART_ROM_SIZE, 1, output_file);
-			fclose(output_file);
+			PRINT_ERROR(L"\nInsufficient memory!");
+			success = false;
 		}
 	}
 
+	// Creates ROM image(s)
+	if (success)
+	{
+		if (g_watch_mode)
+			success = WatchInputFiles(builder, output_file_name);
+		else if (g_benchmark_file_count > 0)
+			success = RunBenchmark(builder, output_file_name);
+		else
+			success = BuildImages(builder, output_file_name);
+
+		KiloCartRelease(builder);
+	}
+	else if (g_benchmark_file_count > 0)
+	{
+		BenchmarkDeleteFiles(g_benchmark_directory, g_benchmark_file_names, g_benchmark_file_count);
+	}
+
 	return (success) ? 0 : -1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Loads all CAS files
-bool LoadFiles()
+// Adds a file to the input files (with the options in effect at its position of the command line)
+bool AddInputFile(wchar_t* in_file_name, KiloCartFileOptions* in_options)
 {
-	int i;
-	bool success = true;
-
-	for (i = 0; i < g_file_info_count && success; i++)
+	if (g_input_file_count >= MAX_FILE_NUMBER)
 	{
-		success = LoadProgramFile(&g_file_info[i]);
+		PRINT_ERROR(L"\nToo many files specified (maximum %d)!", MAX_FILE_NUMBER);
+		return false;
 	}
 
+	wcsncpy_s(g_input_files[g_input_file_count].Filename, MAX_PATH_LENGTH, in_file_name, MAX_PATH_LENGTH);
+	g_input_files[g_input_file_count].Options = *in_options;
+	g_input_file_count++;
+
 	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Load program file
-bool LoadProgramFile(ProgramFileInfo* inout_program_file)
+// Loads and compresses the files, creates and saves the ROM image(s)
+bool BuildImages(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name)
 {
-	FILE* program_file = NULL;
-	bool success = true;
-	CASUPMHeaderType upm_header;
-	CASProgramFileHeaderType program_header;
-	wchar_t display_filename[MAX_PATH_LENGTH];
-	wchar_t file_extension[MAX_PATH_LENGTH];
-	bool cas_file_type = true;
+	bool success;
 
-	// convert and copy file name
-	GetFileNameAndExtension(display_filename, MAX_PATH_LENGTH, inout_program_file->Filename);
-	PRINT_INFO(L"\nLoading: %s", display_filename);
+	KiloCartClearFiles(inout_builder);
 
-	// determine file type by extension
-	GetExtension(file_extension, display_filename);
-	if (_wcsicmp(file_extension, L"CAS") != 0)
-		cas_file_type = false;
+	// Loads CAS files
+	BenchmarkPhaseStart(L"load");
+	success = LoadFiles(inout_builder);
+	BenchmarkPhaseEnd();
 
-	// open program file
-	if (_wfopen_s(&program_file, inout_program_file->Filename, L"rb") != 0 || program_file == NULL)
+	// Compresses files
+	if (success)
 	{
-		PRINT_ERROR(L"\nCan't open file!");
-		return false;
+		BenchmarkPhaseStart(L"compress");
+		success = KiloCartCompressFiles(inout_builder);
+		BenchmarkPhaseEnd();
 	}
 
-	if (cas_file_type)
+	// Creates and saves ROM image(s)
+	if (success)
 	{
-		// load UPM header
-		ReadBlock(program_file, &upm_header, sizeof(upm_header), &success);
-
-		// load program header
-		ReadBlock(program_file, &program_header, sizeof(program_header), &success);
-
-		// Check validity
-		if (!CASCheckHeaderValidity(&program_header))
+		if (g_multi_cartridge)
 		{
-			PRINT_ERROR(L"\nInvalid file!");
-			success = false;
+			// images are saved by the layout phase
+			BenchmarkPhaseStart(L"layout");
+			success = CreateMultiCartridgeImages(inout_builder, in_output_file_name);
+			BenchmarkPhaseEnd();
 		}
-
-		if (!CASCheckUPMHeaderValidity(&upm_header))
+		else
 		{
-			PRINT_ERROR(L"\nInvalid file!");
-			success = false;
-		}
-	}
-	else
-	{
-		// detrmine length
-		fseek(program_file, 0, SEEK_END);
+			BenchmarkPhaseStart(L"layout");
 
-		program_header.FileLength = (uint16_t)ftell(program_file);
-		fseek(program_file, 0, SEEK_SET);
-	}
+			// file placements of the previous image (it is read again by every build of the watch mode)
+			if (g_previous_image_file_name[0] != '\0')
+				success = LoadROMImage(g_previous_image_file_name, g_rom_image) && KiloCartSetPreviousImage(inout_builder, g_rom_image);
 
-	// check size
-	if (success)
-	{
-		if (g_file_buffer_length + program_header.FileLength >= FILE_BUFFER_SIZE)
-		{
-			PRINT_ERROR(L"\nToo many file specified!");
-			success = false;
+			if (success)
+				success = KiloCartBuildImage(inout_builder, g_rom_image);
+
+			BenchmarkPhaseEnd();
+
+			if (success)
+			{
+				BenchmarkPhaseStart(L"write");
+				success = SaveROMImage(in_output_file_name, g_rom_image);
+				BenchmarkPhaseEnd();
+			}
 		}
 	}
 
-	// load program data
-	if (success)
+	// lists changed sectors
+	if (success && g_diff_image_file_name[0] != '\0')
 	{
-		ReadBlock(program_file, g_file_buffer + g_file_buffer_length, program_header.FileLength, &success);
-
-		if (success)
-		{
-			inout_program_file->Length = program_header.FileLength;
-			inout_program_file->BufferPos = g_file_buffer_length;
-			g_file_buffer_length += program_header.FileLength;
-			inout_program_file->ROMAddress = 0;
-		}
-		else
-		{
-			PRINT_ERROR(L"\nFile load error!");
-			success = false;
-		}
+		success = PrintImageDiff(g_rom_image);
 	}
-	
-	// close file
-	if (program_file != NULL)
-		fclose(program_file);
 
 	return success;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Creates ROM image
-bool CreateROMImage(void)
+// Watch mode: builds the image(s) and rebuilds them when an input file is changed
+// or a build request is received on the pipe. Returns when an exit request is
+// received (or on error) with the result of the last build.
+bool WatchInputFiles(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name)
 {
-	bool success = true;
+	wchar_t* file_names[MAX_FILE_NUMBER];
+	bool build_success;
+	bool watching = true;
+	int i;
 
-	do
+	for (i = 0; i < g_input_file_count; i++)
+		file_names[i] = g_input_files[i].Filename;
+
+	// changes are watched from the first build
+	if (!WatchStart(file_names, g_input_file_count, g_pipe_name))
 	{
-		g_rom_image_address = 0;
+		WatchStop();
+		return false;
+	}
 
-		// load loader code
-		if (success)
-			success = CreateROMLoader();
+	build_success = BuildImages(inout_builder, in_output_file_name);
+
+	if (g_pipe_name[0] != '\0')
+		PRINT_INFO(L"\n\nWatching the input files and the '\\\\.\\pipe\\%s' pipe...", g_pipe_name);
+	else
+		PRINT_INFO(L"\n\nWatching the input files (press Ctrl+C to exit)...");
 
-		if (success)
+	while (watching)
+	{
+		switch (WatchWaitForEvent())
 		{
-			// update addresses
-			g_rom_file_system_info_address = g_rom_image_address - sizeof(ROMFileSystemInfo);
-			g_rom_files_address = g_rom_file_system_info_address + sizeof(ROMFileSystemInfo) + sizeof(ROMFileInfo) * g_file_info_count;
-			g_rom_image_address = g_rom_files_address;
+			case WATCH_FILES_CHANGED:
+				build_success = RebuildImages(inout_builder, in_output_file_name);
+				break;
 
-			success = CreateROMFileSystem();
-		}
+			case WATCH_BUILD_REQUEST:
+				// changes which are not notified yet are built before the reply
+				if (WatchUpdateFiles() || !build_success)
+					build_success = RebuildImages(inout_builder, in_output_file_name);
 
-		// check if image is fit into the ROM
-		if (success && g_rom_image_address >= CART_ROM_SIZE)
-		{
-			if (g_compressed_mode)
-			{
-				PRINT_ERROR(L"\nCartridge memory is too low!");
-				success = false;
-			}
-			else
-			{
-				// try compressed mode
-				g_compressed_mode = true;
-			}
-		}
-		else
-		{
-			// add directory to the image 
-			if (success)
-				success = CreateROMDirectory();
+				WatchReply((build_success) ? "ok\n" : "error\n");
+				break;
+
+			case WATCH_EXIT_REQUEST:
+				WatchReply("ok\n");
+				watching = false;
+				break;
+
+			default:
+				PRINT_ERROR(L"\nCan't watch the input files!");
+				build_success = false;
+				watching = false;
+				break;
 		}
+	}
 
-	} while (success && g_rom_image_address >= CART_ROM_SIZE);
+	WatchStop();
 
-	// display statistics
-	if (g_compressed_mode)
-		PRINT_INFO(L"\nCompressed mode statistic:");
-	else
-		PRINT_INFO(L"\nStorage statistics:");
+	return build_success;
+}
 
-	PRINT_INFO(L" %d bytes used, %d bytes free (%d total bytes)", g_rom_image_address, CART_ROM_SIZE - g_rom_image_address, CART_ROM_SIZE);
+///////////////////////////////////////////////////////////////////////////////
+// Rebuilds the image(s) in watch mode and displays the build time
+bool RebuildImages(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name)
+{
+	ULONGLONG start_time;
+	bool success;
 
-	// fill remaining bytes with FFH
-	if (success)
-	{
-		while (g_rom_image_address < CART_ROM_SIZE)
-		{
-			if ((g_rom_image_address % CART_PAGE_SIZE) >= ROM_PAGE_CHANGE_ADDRESS)
-			{
-				// cover page change addresses with some less useful data
-				memcpy(g_rom_image + g_rom_image_address, g_page_end_bytes, sizeof(g_page_end_bytes));
-				g_rom_image_address += sizeof(g_page_end_bytes);
+	PRINT_INFO(L"\n\nRebuilding the image...");
 
-				// copy page start bytes
-				memcpy(g_rom_image + g_rom_image_address, g_page_start_bytes, sizeof(g_page_start_bytes));
-				g_rom_image_address += sizeof(g_page_start_bytes);
-			}
+	start_time = GetTickCount64();
+	success = BuildImages(inout_builder, in_output_file_name);
 
-			g_rom_image[g_rom_image_address++] = 0xff;
-		}
-	}
+	PRINT_INFO(L"\nBuild %s in %llu ms.", (success) ? L"finished" : L"failed", GetTickCount64() - start_time);
 
 	return success;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Creates loader code
-bool CreateROMLoader()
+// Creates the synthetic files of the benchmark ('count,length[,types]' parameter)
+bool CreateBenchmarkFiles(wchar_t* in_parameters)
 {
-	unsigned const char* loader;
-	int loader_length;
+	wchar_t* parameter_end;
+	wchar_t* payloads = L"csr";
+	int file_count;
+	int file_length;
 
-	if (g_compressed_mode)
+	file_count = (int)wcstol(in_parameters, &parameter_end, 0);
+	file_length = 0;
+	if (*parameter_end == ',')
+		file_length = (int)wcstol(parameter_end + 1, &parameter_end, 0);
+
+	if (*parameter_end == ',')
 	{
-		loader = kilocart_decomp_loader_bin;
-		loader_length = kilocart_decomp_loader_bin_size;
+		payloads = parameter_end + 1;
+		parameter_end = payloads + wcsspn(payloads, L"csrCSR");
+		_wcslwr_s(payloads, wcslen(payloads) + 1);
 	}
-	else
+
+	if (*parameter_end != '\0' || payloads[0] == '\0' || file_count <= 0 || file_length <= 0 || file_length > BENCHMARK_MAX_FILE_LENGTH || g_benchmark_file_count > 0)
+	{
+		PRINT_ERROR(L"\nInvalid parameter for option '--benchmark'.");
+		return false;
+	}
+
+	if (g_input_file_count + file_count > MAX_FILE_NUMBER)
 	{
-		loader = kilocart_loader_bin;
-		loader_length = kilocart_loader_bin_size;
+		PRINT_ERROR(L"\nToo many files specified (maximum %d)!", MAX_FILE_NUMBER);
+		return false;
 	}
 
-	// copy loader to ROM image
-	memcpy(g_rom_image, loader, loader_length);
+	GetTempPathW(MAX_PATH_LENGTH, g_benchmark_directory);
+	wcscat_s(g_benchmark_directory, MAX_PATH_LENGTH, L"KiloCartBenchmark\\");
 
-	// update ROM address
-	g_rom_image_address = loader_length;
+	PRINT_INFO(L"\nCreating %d synthetic files (%d bytes average length, '%s' content)", file_count, file_length, payloads);
+
+	g_benchmark_file_count = file_count;
+	if (!BenchmarkCreateFiles(g_benchmark_directory, file_count, file_length, payloads, g_benchmark_file_names))
+	{
+		BenchmarkDeleteFiles(g_benchmark_directory, g_benchmark_file_names, file_count);
+		g_benchmark_file_count = 0;
+		return false;
+	}
 
 	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Creates directory on the ROM image
-bool CreateROMDirectory()
+// Decodes the files of a tape recording into the folder of the recording (name of
+// the recording without extension), the file names are added to the tape files
+bool DecodeTapeRecording(wchar_t* in_wave_file_name, int* out_file_count)
 {
-	ROMFileInfo* file_info;
-	int file_info_address;
-	int file_count = 0;
-	bool file_system_version2x = false;
-	wchar_t buffer[MAX_PATH_LENGTH];
+	wchar_t directory[MAX_PATH_LENGTH];
+	wchar_t* extension;
+	int max_file_count;
+
+	*out_file_count = 0;
+
+	wcscpy_s(directory, MAX_PATH_LENGTH, in_wave_file_name);
+	extension = wcsrchr(directory, '.');
+	if (extension != NULL && wcschr(extension, '\\') == NULL)
+		*extension = '\0';
+	wcscat_s(directory, MAX_PATH_LENGTH, L"\\");
+
+	max_file_count = MAX_FILE_NUMBER - g_input_file_count;
+	if (max_file_count > MAX_FILE_NUMBER - g_tape_file_count)
+		max_file_count = MAX_FILE_NUMBER - g_tape_file_count;
 
-	ROMFileSystemInfo* file_system_info = (ROMFileSystemInfo*)(g_rom_image + g_rom_file_system_info_address);
-	file_system_info->FilesAddress = g_rom_files_address;
-	file_system_info->Directory1xAddress = g_rom_file_system_info_address + sizeof(ROMFileSystemInfo);
+	PRINT_INFO(L"\nDecoding tape recording: %s", in_wave_file_name);
 
-	// create directory entries
-	for (int i = 0; i < g_file_info_count; i++)
+	if (!TapeDecodeWaveFile(in_wave_file_name, directory, max_file_count, g_tape_file_names + g_tape_file_count, out_file_count))
+		return false;
+
+	if (*out_file_count == 0)
 	{
-		file_info_address = g_rom_file_system_info_address + sizeof(ROMFileSystemInfo) + i * sizeof(ROMFileInfo);
-		file_info = (ROMFileInfo*)(g_rom_image + file_info_address);
+		PRINT_ERROR(L"\nNo files found in the recording.");
+		return false;
+	}
 
-		// change to 2x ROM version if required
-		if (g_file_info[i].Version2xFile && !file_system_version2x)
-		{
-			file_system_version2x = true;
-			file_system_info->Files1xCount = (uint8_t)file_count;
-			file_count = 0;
-			file_system_info->Directory2xAddress = (uint16_t)file_info_address;
-		}
+	g_tape_file_count += *out_file_count;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Builds the image(s) with the phase measurement and deletes the synthetic files
+bool RunBenchmark(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name)
+{
+	KiloCartStatistics statistics;
+	bool success;
+
+	BenchmarkStart();
+
+	success = BuildImages(inout_builder, in_output_file_name);
+
+	KiloCartGetStatistics(inout_builder, &statistics);
 
-		// convert and copy file name
-		GetFileNameAndExtension(buffer, MAX_PATH_LENGTH, g_file_info[i].Filename);
-		_wcsupr_s(buffer, MAX_PATH_LENGTH);
-		PCToTVCFilenameAndExtension(file_info->Filename, buffer);
+	BenchmarkPrintReport();
 
-		file_info->Address = g_file_info[i].ROMAddress;
-		file_info->Length = (uint16_t)g_file_info[i].Length;
+	PRINT_INFO(L"\n  Input files: %d (%d bytes), layout passes: %d, build %s", statistics.InputFileCount, statistics.InputLength, statistics.LayoutPassCount,
+		(success) ? L"finished" : ((statistics.Overflow) ? L"failed (cartridge memory is too low)" : L"failed"));
 
-		file_count++;
+	BenchmarkDeleteFiles(g_benchmark_directory, g_benchmark_file_names, g_benchmark_file_count);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Loads all CAS files
+bool LoadFiles(KiloCartBuilder* inout_builder)
+{
+	int i;
+	bool success = true;
+
+	for (i = 0; i < g_input_file_count && success; i++)
+	{
+		success = LoadProgramFile(inout_builder, &g_input_files[i]);
+	}
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Load program file and adds it to the builder (CAS files are added without their headers)
+bool LoadProgramFile(KiloCartBuilder* inout_builder, InputFileInfo* in_input_file)
+{
+	FILE* program_file = NULL;
+	bool success = true;
+	uint8_t* file_data;
+	int file_length;
+	wchar_t display_filename[MAX_PATH_LENGTH];
+	wchar_t file_extension[MAX_PATH_LENGTH];
+
+	// convert and copy file name
+	GetFileNameAndExtension(display_filename, MAX_PATH_LENGTH, in_input_file->Filename);
+	PRINT_INFO(L"\nLoading: %s", display_filename);
+
+	// open program file
+	if (_wfopen_s(&program_file, in_input_file->Filename, L"rb") != 0 || program_file == NULL)
+	{
+		PRINT_ERROR(L"\nCan't open file!");
+		return false;
 	}
 
-	// update file system info
-	if (file_system_version2x)
+	// detrmine length
+	fseek(program_file, 0, SEEK_END);
+	file_length = (int)ftell(program_file);
+	fseek(program_file, 0, SEEK_SET);
+
+	file_data = (uint8_t*)malloc((file_length > 0) ? file_length : 1);
+	if (file_data == NULL)
+	{
+		PRINT_ERROR(L"\nInsufficient memory!");
+		fclose(program_file);
+		return false;
+	}
+
+	// load file content
+	ReadBlock(program_file, file_data, file_length, &success);
+	fclose(program_file);
+
+	if (!success)
 	{
-		file_system_info->Files2xCount = file_count;
+		PRINT_ERROR(L"\nFile load error!");
 	}
 	else
 	{
-		file_system_info->Files1xCount = file_count;
-		file_system_info->Directory2xAddress = file_system_info->Directory1xAddress;
-		file_system_info->Files2xCount = file_system_info->Files1xCount;
+		// determine file type by extension
+		GetExtension(file_extension, display_filename);
+
+		if (_wcsicmp(file_extension, L"CAS") == 0)
+			success = KiloCartAddCASFile(inout_builder, in_input_file->Filename, file_data, file_length, &in_input_file->Options);
+		else
+			success = KiloCartAddFile(inout_builder, in_input_file->Filename, file_data, file_length, &in_input_file->Options);
 	}
 
+	free(file_data);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Saves ROM image
+bool SaveROMImage(wchar_t* in_file_name, uint8_t* in_image)
+{
+	FILE* output_file = NULL;
+
+	if (_wfopen_s(&output_file, in_file_name, L"wb") != 0 || output_file == NULL)
+	{
+		PRINT_ERROR(L"\nCan't create file: %s", in_file_name);
+		return false;
+	}
+
+	fwrite(in_image, CART_ROM_SIZE, 1, output_file);
+	fclose(output_file);
+
 	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Creates files on the ROM image
-bool CreateROMFileSystem()
+// Creates as many ROM images as required for the files (starting from one image)
+// and saves the images and the catalog of the cartridges
+bool CreateMultiCartridgeImages(KiloCartBuilder* inout_builder, wchar_t* in_output_file_name)
 {
-	int j;
-	int byte_count;
-	uint8_t* compressed_data = NULL;
-	size_t compressed_size = 0;
-	int length;
-	uint8_t* source;
-
-	// generate files in the ROM
-	for (int i = 0; i < g_file_info_count; i++)
-	{
-		// check if file is already in the ROM image
-		j = 0;
-		while (j < i)
-		{
-			if (CompareFilenames(g_file_info[i].Filename, g_file_info[j].Filename) == 0)
-				break;
+	wchar_t image_file_names[MAX_CARTRIDGE_COUNT][MAX_PATH_LENGTH];
+	uint8_t* images;
+	wchar_t catalog_file_name[MAX_PATH_LENGTH];
+	FILE* catalog_file = NULL;
+	int cartridge_count;
+	int cartridge;
+	bool success;
+
+	images = (uint8_t*)malloc((size_t)MAX_CARTRIDGE_COUNT * CART_ROM_SIZE);
+	if (images == NULL)
+	{
+		PRINT_ERROR(L"\nInsufficient memory!");
+		return false;
+	}
 
-			j++;
-		}
+	success = KiloCartBuildMultiCartridgeImages(inout_builder, images, &cartridge_count);
+
+	// save images and catalog
+	for (cartridge = 0; cartridge < cartridge_count && success; cartridge++)
+	{
+		GetCartridgeFileName(image_file_names[cartridge], in_output_file_name, cartridge, cartridge_count);
+		success = SaveROMImage(image_file_names[cartridge], images + (size_t)cartridge * CART_ROM_SIZE);
+	}
+
+	if (success)
+	{
+		PRINT_INFO(L"\n\n");
+		KiloCartPrintCatalog(inout_builder, stdout, image_file_names);
 
-		if (j < i)
+		GetCartridgeFileName(catalog_file_name, in_output_file_name, -1, 1);
+
+		if (_wfopen_s(&catalog_file, catalog_file_name, L"wt") == 0 && catalog_file != NULL)
 		{
-			// file already included in the image, copy only the address
-			g_file_info[i].ROMAddress = g_file_info[j].ROMAddress;
+			KiloCartPrintCatalog(inout_builder, catalog_file, image_file_names);
+			fclose(catalog_file);
 		}
 		else
 		{
-			// update ROM address
-			g_file_info[i].ROMAddress = g_rom_image_address;
+			PRINT_ERROR(L"\nCan't create file: %s", catalog_file_name);
+			success = false;
+		}
+	}
 
-			if (g_compressed_mode)
-			{
-				compressed_data = ZX7Compress(ZX7Optimize(g_file_buffer + g_file_info[i].BufferPos, g_file_info[i].Length), g_file_buffer + g_file_info[i].BufferPos, g_file_info[i].Length, &compressed_size);
-				length = (int)compressed_size;
-				source = compressed_data;
-			}
-			else
-			{
-				source = (uint8_t*)(g_file_buffer + g_file_info[i].BufferPos);
-				length = g_file_info[i].Length;
-			}
+	free(images);
 
-			// copy file to the ROM image
-			for (byte_count = 0; byte_count < length; byte_count++)
-			{
-				if ((g_rom_image_address % CART_PAGE_SIZE) >= ROM_PAGE_CHANGE_ADDRESS)
-				{
-					// cover page change addresses with some less useful data
-					memcpy(g_rom_image + g_rom_image_address, g_page_end_bytes, sizeof(g_page_end_bytes));
-					g_rom_image_address += sizeof(g_page_end_bytes);
+	return success;
+}
 
-					// copy page start bytes
-					memcpy(g_rom_image + g_rom_image_address, g_page_start_bytes, sizeof(g_page_start_bytes));
-					g_rom_image_address += sizeof(g_page_start_bytes);
-				}
+///////////////////////////////////////////////////////////////////////////////
+// Gets the image file name of a cartridge ('_1', '_2', ... suffix is added to the output
+// file name when there are more cartridges) or the catalog file name (index is -1)
+void GetCartridgeFileName(wchar_t* out_file_name, wchar_t* in_output_file_name, int in_cartridge_index, int in_cartridge_count)
+{
+	wchar_t* extension;
+	size_t name_length;
 
-				g_rom_image[g_rom_image_address++] = *source;
-				source++;
-			}
+	extension = wcsrchr(in_output_file_name, '.');
+	if (extension == NULL || wcschr(extension, '\\') != NULL)
+		extension = in_output_file_name + wcslen(in_output_file_name);
 
-			if(g_compressed_mode)
-			{
-				free(compressed_data);
-			}
+	name_length = extension - in_output_file_name;
+
+	wcscpy_s(out_file_name, MAX_PATH_LENGTH, in_output_file_name);
+
+	if (in_cartridge_index < 0)
+		swprintf_s(out_file_name + name_length, MAX_PATH_LENGTH - name_length, L".txt");
+	else if (in_cartridge_count > 1)
+		swprintf_s(out_file_name + name_length, MAX_PATH_LENGTH - name_length, L"_%d%s", in_cartridge_index + 1, extension);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Loads a previously created ROM image
+bool LoadROMImage(wchar_t* in_file_name, uint8_t* out_image)
+{
+	FILE* image_file = NULL;
+	bool success = true;
+
+	if (_wfopen_s(&image_file, in_file_name, L"rb") != 0 || image_file == NULL)
+	{
+		PRINT_ERROR(L"\nCan't open ROM image: %s", in_file_name);
+		return false;
+	}
+
+	if (fread(out_image, 1, CART_ROM_SIZE, image_file) != CART_ROM_SIZE || fgetc(image_file) != EOF)
+	{
+		PRINT_ERROR(L"\nInvalid ROM image size: %s", in_file_name);
+		success = false;
+	}
+
+	fclose(image_file);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays the erase sectors which are different from the previous ROM image
+bool PrintImageDiff(uint8_t* in_image)
+{
+	uint8_t* previous_image;
+	int changed_count = 0;
+	int address;
+
+	previous_image = (uint8_t*)malloc(CART_ROM_SIZE);
+	if (previous_image == NULL)
+	{
+		PRINT_ERROR(L"\nInsufficient memory!");
+		return false;
+	}
+
+	if (!LoadROMImage(g_diff_image_file_name, previous_image))
+	{
+		free(previous_image);
+		return false;
+	}
+
+	PRINT_INFO(L"\nChanged sectors (%d bytes sector size):", g_sector_size);
+
+	for (address = 0; address < CART_ROM_SIZE; address += g_sector_size)
+	{
+		if (memcmp(previous_image + address, in_image + address, g_sector_size) != 0)
+		{
+			PRINT_INFO(L"\n  Sector %d (0x%04X-0x%04X): CRC32 %08X -> %08X", address / g_sector_size, address, address + g_sector_size - 1,
+				KiloCartCalculateCRC32(previous_image + address, g_sector_size), KiloCartCalculateCRC32(in_image + address, g_sector_size));
+			changed_count++;
 		}
 	}
 
+	PRINT_INFO(L"\n  %d of %d sectors changed", changed_count, CART_ROM_SIZE / g_sector_size);
+
+	free(previous_image);
+
 	return true;
-}
\ No newline at end of file
+}
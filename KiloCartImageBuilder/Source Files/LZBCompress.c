@@ -0,0 +1,308 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Byte-aligned LZ compressor (fast decompression by LDIR)                   */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "LZBCompress.h"
+#include "ZX7Compress.h"
+#include "FastParse.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+
+// Parse cost is the number of bytes (upper 32 bits) and the decompression time of the
+// tokens (lower 32 bits), therefore the faster one is selected from the equal length parses
+#define COST_BYTES(x) ((unsigned long long)(x) << 32)
+#define LITERAL_RUN_TIME 65		// approximate T-states of a token without the LDIR bytes
+#define MATCH_TIME 200
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static bool OptimalParse(uint8_t* in_input_data, size_t in_input_size, int in_max_offset, unsigned short* out_length, unsigned short* out_offset);
+static bool FastParse(uint8_t* in_input_data, size_t in_input_size, int in_max_offset, unsigned short* out_length, unsigned short* out_offset);
+static size_t FindEncodableMatch(FastMatchFinder* in_finder, size_t in_position, int* out_offset);
+static int GetMatchCost(int in_offset, int in_length);
+
+///////////////////////////////////////////////////////////////////////////////
+// Compresses data using the optimal (shortest in bytes) parse or the fast lazy
+// matching parse. Matches are searched within the given offset window.
+uint8_t* LZBCompress(uint8_t* in_input_data, size_t in_input_size, int in_max_offset, bool in_fast_parse, size_t* out_output_size)
+{
+	unsigned short* length;
+	unsigned short* offset;
+	size_t* path;
+	size_t path_length;
+	size_t position;
+	size_t i;
+	uint8_t* output_data;
+	size_t output_size;
+	bool success;
+
+	// length[i] and offset[i] are the sequence of the parse which ends before the
+	// i-th input byte (offset 0 is a literal run)
+	length = (unsigned short*)malloc((in_input_size + 1) * sizeof(unsigned short));
+	offset = (unsigned short*)malloc((in_input_size + 1) * sizeof(unsigned short));
+	path = (size_t*)malloc((in_input_size + 1) * sizeof(size_t));
+	output_data = (uint8_t*)malloc(in_input_size + in_input_size / LZB_MAX_LITERAL_RUN + 4);
+
+	success = (length != NULL && offset != NULL && path != NULL && output_data != NULL);
+
+	if (success)
+	{
+		if (in_fast_parse)
+			success = FastParse(in_input_data, in_input_size, in_max_offset, length, offset);
+		else
+			success = OptimalParse(in_input_data, in_input_size, in_max_offset, length, offset);
+	}
+
+	if (!success)
+	{
+		free(output_data);
+		free(path);
+		free(offset);
+		free(length);
+
+		return NULL;
+	}
+
+	// collect the parse path from the end
+	path_length = 0;
+	position = in_input_size;
+	while (position > 0)
+	{
+		path[path_length++] = position;
+		position -= length[position];
+	}
+
+	// generate output
+	output_size = 0;
+	position = 0;
+	while (path_length > 0)
+	{
+		i = path[--path_length];
+
+		if (offset[i] == 0)
+		{
+			output_data[output_size++] = (uint8_t)(length[i] - 1);
+			for (; position < i; position++)
+				output_data[output_size++] = in_input_data[position];
+		}
+		else
+		{
+			if (GetMatchCost(offset[i], length[i]) == 2)
+			{
+				output_data[output_size++] = (uint8_t)(LZB_SHORT_MATCH_TOKEN | (length[i] - LZB_MIN_SHORT_MATCH));
+				output_data[output_size++] = (uint8_t)(offset[i] - 1);
+			}
+			else
+			{
+				output_data[output_size++] = (uint8_t)(LZB_LONG_MATCH_TOKEN | (length[i] - LZB_MIN_LONG_MATCH));
+				output_data[output_size++] = (uint8_t)(offset[i] & 0xff);
+				output_data[output_size++] = (uint8_t)(offset[i] >> 8);
+			}
+
+			position = i;
+		}
+	}
+
+	// end marker
+	output_data[output_size++] = LZB_LONG_MATCH_TOKEN;
+	output_data[output_size++] = 0;
+	output_data[output_size++] = 0;
+
+	free(path);
+	free(offset);
+	free(length);
+
+	*out_output_size = output_size;
+
+	return output_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the optimal parse. Match candidates are collected by the ZX7 match finder.
+// Returns false if there is not enough memory.
+static bool OptimalParse(uint8_t* in_input_data, size_t in_input_size, int in_max_offset, unsigned short* out_length, unsigned short* out_offset)
+{
+	MatchTable* matches;
+	unsigned long long* cost;
+	unsigned int* first;
+	unsigned int candidate;
+	unsigned long long sequence_cost;
+	int match_cost;
+	size_t run;
+	size_t len;
+	size_t max_len;
+	size_t i;
+
+	// cost[i] is the cost of the first i input bytes
+	cost = (unsigned long long*)malloc((in_input_size + 1) * sizeof(unsigned long long));
+	if (cost == NULL)
+		return false;
+
+	matches = (in_input_size > 0) ? ZX7FindMatches(in_input_data, in_input_size, in_max_offset, 0, in_input_size) : NULL;
+	if (in_input_size > 0 && matches == NULL)
+	{
+		free(cost);
+		return false;
+	}
+
+	first = (matches != NULL) ? matches->first : NULL;
+
+	cost[0] = 0;
+	for (i = 1; i <= in_input_size; i++)
+	{
+		// literal run
+		cost[i] = ULLONG_MAX;
+		for (run = 1; run <= LZB_MAX_LITERAL_RUN && run <= i; run++)
+		{
+			sequence_cost = cost[i - run] + COST_BYTES(run + 1) + LITERAL_RUN_TIME;
+			if (sequence_cost < cost[i])
+			{
+				cost[i] = sequence_cost;
+				out_length[i] = (unsigned short)run;
+				out_offset[i] = 0;
+			}
+		}
+
+		// matches ending at the last byte (a candidate covers the lengths after the previous candidate)
+		len = 2;
+		for (candidate = first[i - 1]; candidate < first[i] && len <= LZB_MAX_LONG_MATCH; candidate++)
+		{
+			max_len = matches->len[candidate];
+			if (max_len > LZB_MAX_LONG_MATCH)
+				max_len = LZB_MAX_LONG_MATCH;
+
+			for (; len <= max_len; len++)
+			{
+				match_cost = GetMatchCost(matches->offset[candidate], (int)len);
+				if (match_cost == 0)
+					continue;
+
+				sequence_cost = cost[i - len] + COST_BYTES(match_cost) + MATCH_TIME;
+				if (sequence_cost < cost[i])
+				{
+					cost[i] = sequence_cost;
+					out_length[i] = (unsigned short)len;
+					out_offset[i] = matches->offset[candidate];
+				}
+			}
+		}
+	}
+
+	if (matches != NULL)
+		ZX7FreeMatchTable(matches);
+
+	free(cost);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates parse by lazy matching: the match of the position is used unless the
+// next position has a longer one. Literals are collected into runs. Returns false
+// if there is not enough memory.
+static bool FastParse(uint8_t* in_input_data, size_t in_input_size, int in_max_offset, unsigned short* out_length, unsigned short* out_offset)
+{
+	FastMatchFinder finder;
+	size_t position = 0;
+	size_t run = 0;
+	size_t length;
+	size_t next_length;
+	int offset;
+	int next_offset;
+
+	if (!FastMatchInit(&finder, in_input_data, in_input_size, in_max_offset))
+		return false;
+
+	length = FindEncodableMatch(&finder, position, &offset);
+
+	while (position < in_input_size)
+	{
+		next_length = FindEncodableMatch(&finder, position + 1, &next_offset);
+
+		if (length == 0 || next_length > length)
+		{
+			// add literal to the run
+			position++;
+			run++;
+			if (run == LZB_MAX_LITERAL_RUN)
+			{
+				out_length[position] = (unsigned short)run;
+				out_offset[position] = 0;
+				run = 0;
+			}
+
+			length = next_length;
+			offset = next_offset;
+		}
+		else
+		{
+			// close literal run and store the match
+			if (run > 0)
+			{
+				out_length[position] = (unsigned short)run;
+				out_offset[position] = 0;
+				run = 0;
+			}
+
+			position += length;
+			out_length[position] = (unsigned short)length;
+			out_offset[position] = (unsigned short)offset;
+
+			length = FindEncodableMatch(&finder, position, &offset);
+		}
+	}
+
+	if (run > 0)
+	{
+		out_length[position] = (unsigned short)run;
+		out_offset[position] = 0;
+	}
+
+	FastMatchFree(&finder);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds match at the position and shortens it to the longest encodable length
+// (returns 0 if the match can't be encoded)
+static size_t FindEncodableMatch(FastMatchFinder* in_finder, size_t in_position, int* out_offset)
+{
+	size_t length;
+
+	length = FastMatchFind(in_finder, in_position, LZB_MAX_LONG_MATCH, out_offset);
+
+	if (*out_offset <= LZB_MAX_SHORT_OFFSET && length >= LZB_MIN_SHORT_MATCH)
+		return (length > LZB_MAX_SHORT_MATCH) ? LZB_MAX_SHORT_MATCH : length;
+
+	if (length >= LZB_MIN_LONG_MATCH)
+		return length;
+
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the number of bytes of a match (0 if the match can't be encoded)
+static int GetMatchCost(int in_offset, int in_length)
+{
+	if (in_offset <= LZB_MAX_SHORT_OFFSET && in_length >= LZB_MIN_SHORT_MATCH && in_length <= LZB_MAX_SHORT_MATCH)
+		return 2;
+
+	if (in_length >= LZB_MIN_LONG_MATCH && in_length <= LZB_MAX_LONG_MATCH)
+		return 3;
+
+	return 0;
+}
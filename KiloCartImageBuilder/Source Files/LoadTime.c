@@ -0,0 +1,424 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Load time estimation of the loader copy routines                          */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdbool.h>
+#include "LoadTime.h"
+#include "CodeFilter.h"
+#include "VideoFilter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+
+// ROM page layout (offset within the page)
+#define PAGE_SIZE 16384
+#define PAGE_DATA_START 0x0007		// after the page start bytes
+#define PAGE_LAST_BYTES 0x3f00		// high byte of the CART address is $FF
+#define PAGE_CHANGE_ADDRESS 0x3ffc	// page select addresses
+
+// T-states of the loader routines (see ramfunctions.a80)
+#define T_CALL 17
+#define T_CHANGE_ROM_PAGE 90								// CHANGE_ROM_PAGE including return
+#define T_UPDATE_SOURCE_ADDRESS 54					// UPDATE_SOURCE_ADDRESS, high byte is less than $FF
+#define T_UPDATE_SOURCE_ADDRESS_LAST_BYTES 72	// UPDATE_SOURCE_ADDRESS, high byte is $FF
+#define T_UPDATE_SOURCE_ADDRESS_SWITCH (77 + T_CALL + T_CHANGE_ROM_PAGE + 30)	// UPDATE_SOURCE_ADDRESS, page is switched
+
+#define T_RAW_COPY_BYTE 44						// PROGRAM_COPY_LOOP, high byte is less than $FF
+#define T_RAW_COPY_BYTE_LAST_BYTES 62	// PROGRAM_COPY_LOOP, high byte is $FF
+#define T_RAW_COPY_SWITCH (57 + 12)			// PROGRAM_COPY_LOOP, page end reached (without UPDATE_SOURCE_ADDRESS)
+#define T_RAW_COPY_END 27							// last byte (LDI and RET PO)
+
+#define T_NEXT_BIT 15									// dzx7s_next_bit, bit buffer is not empty
+#define T_NEXT_BIT_LOAD 36						// dzx7s_next_bit, next byte is loaded (without UPDATE_SOURCE_ADDRESS)
+#define T_COPY_SETUP (50 + 23 + T_CALL)		// CONTINUE_PROGRAM_COPY paging setup and return, call of the copy routine
+
+#define T_LZB_DISPATCH 32							// storage mode check of LZB_COPY in CONTINUE_PROGRAM_COPY
+#define T_LZB_TOKEN (4 + 4 + 7 + 7 + 6 + 4 + 7)	// page end check and control byte load (without UPDATE_SOURCE_ADDRESS)
+#define T_LZB_LITERALS (4 + 4 + 4 + 7)					// literal run length
+#define T_LZB_SHORT_MATCH (5 + 4 + 7 + 4 + 4 + 7 + 4 + 7 + 7 + 6 + 11 + 4 + 4 + 12)	// short match length and offset
+#define T_LZB_LONG_MATCH (5 + 4 + 12 + 4 + 4 + 7 + 4 + 7 + 6 + 7 + 6 + 11 + 4 + 4 + 4)	// long match length and offset
+#define T_LZB_COPY_MATCH (11 + 4 + 4 + 15 + 10 - 5 + 10 + 12)	// LZB_COPY_MATCH without the LDIR bytes
+#define T_LZB_EXIT (12 + 10 + 10)
+
+#define T_CODE_FILTER_SETUP (11 + 19 + 10 + T_CALL + 25 + 157 + 30)	// destination saved by CONTINUE_PROGRAM_COPY, DECODE_FILTER setup and exit
+#define T_CODE_FILTER_BYTE 54							// CODE_FILTER_LOOP, byte is less than $C2
+#define T_CODE_FILTER_HIGH_BYTE 119				// CODE_FILTER_LOOP, byte is not a filtered opcode but at least $C2
+#define T_CODE_FILTER_INSTRUCTION (70 + 191)	// opcode check (average) and CODE_FILTER_OPERAND
+#define T_ROW_DELTA_SETUP (20 + T_CALL + 33 + 88 + 40)	// flag check, DECODE_ROW_DELTA setup and exit
+#define T_ROW_DELTA_BYTE 46								// ROW_DELTA_LOOP
+#define T_ROW_DELTA_ROUND 11							// DEC C and JR of every 256 bytes
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	uint8_t* Data;
+	int Length;
+	int Position;
+	int PageOffset;
+	uint8_t BitBuffer;
+	long long TStates;
+} DecompressionReplay;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static int UpdateSourceAddress(int* inout_page_offset);
+static bool NextBit(DecompressionReplay* in_replay);
+static uint8_t NextByte(DecompressionReplay* in_replay);
+static long long CopyLoopTime(int* inout_page_offset, int in_length);
+static uint8_t NextLZBByte(DecompressionReplay* in_replay, bool in_page_end);
+
+///////////////////////////////////////////////////////////////////////////////
+// Estimates T-states of NONCOMPRESSED_COPY including the page switches
+long long EstimateRawCopyTime(int in_rom_address, int in_length)
+{
+	long long t_states;
+	int page_offset = in_rom_address % PAGE_SIZE;
+
+	// CONTINUE_PROGRAM_COPY selects the page and skips the page end
+	t_states = T_COPY_SETUP + T_CALL + T_CHANGE_ROM_PAGE + UpdateSourceAddress(&page_offset);
+
+	return t_states + CopyLoopTime(&page_offset, in_length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Estimates T-states of dzx7_standard by replaying it over the compressed data
+// (long offsets have in_offset_bits extra bits)
+long long EstimateDecompressionTime(uint8_t* in_compressed_data, int in_compressed_length, int in_rom_address, int in_offset_bits)
+{
+	DecompressionReplay replay;
+	int length_bits;
+	int length;
+	uint8_t offset;
+	bool bit;
+	int i;
+
+	replay.Data = in_compressed_data;
+	replay.Length = in_compressed_length;
+	replay.Position = 0;
+	replay.PageOffset = in_rom_address % PAGE_SIZE;
+	replay.BitBuffer = 0x80;
+
+	// CONTINUE_PROGRAM_COPY selects the page and skips the page end, dzx7_standard loads the bit marker
+	replay.TStates = T_COPY_SETUP + T_CALL + T_CHANGE_ROM_PAGE + UpdateSourceAddress(&replay.PageOffset) + 7;
+
+	// first byte is always literal
+	replay.TStates += 16;
+	NextByte(&replay);
+
+	while (replay.Position < replay.Length)
+	{
+		// literal or sequence
+		bit = NextBit(&replay);
+		if (!bit)
+		{
+			// copy literal byte
+			replay.TStates += 12 + 16;
+			NextByte(&replay);
+			continue;
+		}
+
+		replay.TStates += 7 + 25;
+
+		// determine number of bits used for length (Elias gamma coding)
+		length_bits = 0;
+		do
+		{
+			length_bits++;
+			bit = NextBit(&replay);
+			replay.TStates += 4 + ((bit) ? 7 : 12);
+		} while (!bit);
+
+		// determine length
+		length = 0;
+		while (true)
+		{
+			if (!bit)
+				bit = NextBit(&replay);
+			else
+				replay.TStates += 10;
+
+			length = (length << 1) | ((bit) ? 1 : 0);
+			replay.TStates += 16;
+
+			// end marker
+			if (length > 0xffff)
+			{
+				replay.TStates += 12 + 10 + 7 + T_NEXT_BIT;
+				return replay.TStates;
+			}
+
+			replay.TStates += 7 + 4;
+
+			bit = false;
+			if (--length_bits == 0)
+			{
+				replay.TStates += 7;
+				break;
+			}
+
+			replay.TStates += 12;
+		}
+		length++;
+		replay.TStates += 6;
+
+		// determine offset
+		replay.TStates += 13;
+		offset = NextByte(&replay);
+		replay.TStates += 12;
+		if (offset & 0x80)
+		{
+			// load the extra bits
+			replay.TStates += 7 + 7;
+			for (i = 0; i < in_offset_bits; i++)
+			{
+				NextBit(&replay);
+				replay.TStates += 8 + ((i < in_offset_bits - 1) ? 12 : 7);
+			}
+			replay.TStates += 12;
+		}
+		else
+		{
+			replay.TStates += 12;
+		}
+
+		// copy previous sequence
+		replay.TStates += 8 + 55 + 21 * (long long)length - 5 + 10 + 12;
+	}
+
+	return replay.TStates;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Estimates T-states of LZB_COPY by replaying it over the compressed data
+long long EstimateLZBDecompressionTime(uint8_t* in_compressed_data, int in_compressed_length, int in_rom_address)
+{
+	DecompressionReplay replay;
+	uint8_t control;
+	bool page_end;
+	int length;
+	int offset;
+
+	replay.Data = in_compressed_data;
+	replay.Length = in_compressed_length;
+	replay.Position = 0;
+	replay.PageOffset = in_rom_address % PAGE_SIZE;
+
+	// CONTINUE_PROGRAM_COPY selects the page and skips the page end
+	replay.TStates = T_COPY_SETUP + T_LZB_DISPATCH + T_CALL + T_CHANGE_ROM_PAGE + UpdateSourceAddress(&replay.PageOffset);
+
+	while (replay.Position < replay.Length)
+	{
+		// the source address is checked only for the tokens near the page end
+		page_end = (replay.PageOffset >= PAGE_LAST_BYTES);
+		replay.TStates += T_LZB_TOKEN + ((page_end) ? 5 : 0);
+
+		control = NextLZBByte(&replay, page_end);
+
+		if ((control & 0x80) == 0)
+		{
+			// literal run is copied by LDIR, near the page end by NONCOMPRESSED_COPY
+			length = control + 1;
+			replay.TStates += T_LZB_LITERALS;
+
+			if (page_end)
+			{
+				replay.TStates += T_CALL + CopyLoopTime(&replay.PageOffset, length) + UpdateSourceAddress(&replay.PageOffset) + 12;
+			}
+			else
+			{
+				replay.TStates += 21 * (long long)length - 5 + 12;
+				replay.PageOffset += length;
+			}
+
+			replay.Position += length;
+			continue;
+		}
+
+		if ((control & 0x40) == 0)
+		{
+			// short match
+			length = (control & 0x3f) + 3;
+			replay.TStates += T_LZB_SHORT_MATCH;
+			NextLZBByte(&replay, page_end);
+		}
+		else
+		{
+			// long match (offset 0 is the end marker)
+			length = (control & 0x3f) + 4;
+			replay.TStates += T_LZB_LONG_MATCH;
+			offset = NextLZBByte(&replay, page_end);
+			offset |= NextLZBByte(&replay, page_end) << 8;
+			if (offset == 0)
+				return replay.TStates + T_LZB_EXIT;
+
+			replay.TStates += 7 + 6 + 7 + ((page_end) ? 12 : 0);
+		}
+
+		replay.TStates += T_LZB_COPY_MATCH + 21 * (long long)length;
+	}
+
+	return replay.TStates;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Estimates T-states of DECODE_FILTER (code filter) by replaying it over the restored data
+long long EstimateCodeFilterTime(uint8_t* in_data, int in_length)
+{
+	long long t_states = T_CODE_FILTER_SETUP;
+	int i;
+
+	i = 0;
+	while (i + CODE_FILTER_INSTRUCTION_LENGTH <= in_length)
+	{
+		if (IsCodeFilterOpcode(in_data[i]))
+		{
+			t_states += T_CODE_FILTER_INSTRUCTION;
+			i += CODE_FILTER_INSTRUCTION_LENGTH;
+		}
+		else
+		{
+			t_states += (in_data[i] < 0xc2) ? T_CODE_FILTER_BYTE : T_CODE_FILTER_HIGH_BYTE;
+			i++;
+		}
+	}
+
+	return t_states;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Estimates T-states of DECODE_ROW_DELTA (row delta filter)
+long long EstimateRowDeltaTime(int in_length)
+{
+	long long t_states = T_ROW_DELTA_SETUP;
+	int length = in_length - VIDEO_ROW_LENGTH;
+
+	if (length > 0)
+		t_states += (long long)length * T_ROW_DELTA_BYTE + ((length + 255) / 256) * T_ROW_DELTA_ROUND;
+
+	return t_states;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Converts T-states to milliseconds
+int TStatesToMilliseconds(long long in_t_states)
+{
+	return (int)((in_t_states * 1000 + Z80_CLOCK_FREQUENCY / 2) / Z80_CLOCK_FREQUENCY);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets T-states of the UPDATE_SOURCE_ADDRESS call (and switches page when the page end is reached)
+static int UpdateSourceAddress(int* inout_page_offset)
+{
+	if (*inout_page_offset < PAGE_LAST_BYTES)
+		return T_CALL + T_UPDATE_SOURCE_ADDRESS;
+
+	if (*inout_page_offset < PAGE_CHANGE_ADDRESS)
+		return T_CALL + T_UPDATE_SOURCE_ADDRESS_LAST_BYTES;
+
+	*inout_page_offset = PAGE_DATA_START;
+
+	return T_CALL + T_UPDATE_SOURCE_ADDRESS_SWITCH;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads the next bit of the compressed data (dzx7s_next_bit)
+static bool NextBit(DecompressionReplay* in_replay)
+{
+	bool bit;
+
+	in_replay->TStates += T_CALL;
+
+	bit = (in_replay->BitBuffer & 0x80) != 0;
+	in_replay->BitBuffer <<= 1;
+
+	if (in_replay->BitBuffer != 0)
+	{
+		in_replay->TStates += T_NEXT_BIT;
+		return bit;
+	}
+
+	// load next 8 bits (the marker bit is shifted in)
+	in_replay->BitBuffer = NextByte(in_replay);
+	in_replay->TStates += T_NEXT_BIT_LOAD;
+
+	bit = (in_replay->BitBuffer & 0x80) != 0;
+	in_replay->BitBuffer = (uint8_t)((in_replay->BitBuffer << 1) | 1);
+
+	return bit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads the next byte of the LZB data (UPDATE_SOURCE_ADDRESS is called only near the page end)
+static uint8_t NextLZBByte(DecompressionReplay* in_replay, bool in_page_end)
+{
+	uint8_t data = 0;
+
+	if (in_page_end)
+		return NextByte(in_replay);
+
+	if (in_replay->Position < in_replay->Length)
+		data = in_replay->Data[in_replay->Position];
+
+	in_replay->Position++;
+	in_replay->PageOffset++;
+
+	return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets T-states of the PROGRAM_COPY_LOOP (page switches included)
+static long long CopyLoopTime(int* inout_page_offset, int in_length)
+{
+	long long t_states = 0;
+	int i;
+
+	for (i = 0; i < in_length; i++)
+	{
+		(*inout_page_offset)++;
+
+		if (i == in_length - 1)
+		{
+			t_states += T_RAW_COPY_END;
+		}
+		else if (*inout_page_offset < PAGE_LAST_BYTES)
+		{
+			t_states += T_RAW_COPY_BYTE;
+		}
+		else if (*inout_page_offset < PAGE_CHANGE_ADDRESS)
+		{
+			t_states += T_RAW_COPY_BYTE_LAST_BYTES;
+		}
+		else
+		{
+			t_states += T_RAW_COPY_SWITCH + UpdateSourceAddress(inout_page_offset);
+		}
+	}
+
+	return t_states;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads the next byte of the compressed data (T-states of the UPDATE_SOURCE_ADDRESS call only)
+static uint8_t NextByte(DecompressionReplay* in_replay)
+{
+	uint8_t data = 0;
+
+	if (in_replay->Position < in_replay->Length)
+		data = in_replay->Data[in_replay->Position];
+
+	in_replay->Position++;
+	in_replay->PageOffset++;
+	in_replay->TStates += UpdateSourceAddress(&in_replay->PageOffset);
+
+	return data;
+}
@@ -0,0 +1,711 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Tape recording (WAV) decoder                                              */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <Windows.h>
+#include "CASFile.h"
+#include "CharMap.h"
+#include "FileUtils.h"
+#include "TapeWave.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define TAPE_READ_BUFFER_SAMPLES 65536			// samples processed at once
+#define TAPE_MIN_SAMPLE_RATE 8000
+#define TAPE_LOWPASS_FREQUENCY 8000					// cutoff frequency of the noise filter (Hz)
+#define TAPE_DC_TIME_CONSTANT 0.02f					// DC level tracking (s)
+#define TAPE_ENVELOPE_TIME_CONSTANT 0.005f	// peak level tracking (s)
+#define TAPE_HYSTERESIS_RATIO 0.2f					// hysteresis of the zero crossing detector (relative to the peak level)
+#define TAPE_MIN_LEVEL 0.02f								// smaller signals are handled as silence (relative to the full scale)
+
+#define TAPE_MIN_LEADING_LENGTH 256					// periods of the leading tone required before the sync
+#define TAPE_LEADING_AVERAGE_LENGTH 64			// periods of the leading tone average (follows the speed changes)
+#define TAPE_LEADING_TOLERANCE 0.15f				// allowed period difference in the leading tone (relative)
+
+// Period thresholds relative to the leading tone period (halfway between the nominal periods)
+#define TAPE_BIT_THRESHOLD (((float)TAPE_FREQ_LEADING / TAPE_FREQ_BIT1 + (float)TAPE_FREQ_LEADING / TAPE_FREQ_BIT0) / 2)
+#define TAPE_SYNC_THRESHOLD (((float)TAPE_FREQ_LEADING / TAPE_FREQ_BIT0 + (float)TAPE_FREQ_LEADING / TAPE_FREQ_SYNC) / 2)
+
+#define TAPE_MAX_SECTOR_COUNT 256
+#define TAPE_CRC_POLYNOMIAL 0x1021
+#define TAPE_MAX_NAME_SUFFIX 99
+
+#define WAVE_FORMAT_PCM_TAG 0x0001
+#define WAVE_FORMAT_EXTENSIBLE_TAG 0xfffe
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+#pragma pack(push, 1)
+
+typedef struct
+{
+	char ID[4];
+	uint32_t Length;
+} WaveChunkHeaderType;
+
+typedef struct
+{
+	uint16_t FormatTag;
+	uint16_t ChannelCount;
+	uint32_t SampleRate;
+	uint32_t ByteRate;
+	uint16_t BlockAlign;
+	uint16_t BitsPerSample;
+} WaveFormatType;
+
+#pragma pack(pop)
+
+// Streaming reader and zero crossing detector of the recording
+typedef struct
+{
+	FILE* File;
+	int ChannelCount;
+	int BytesPerSample;
+	int SampleRate;
+	uint32_t RemainingBytes;				// unread bytes of the data chunk
+	float SamplePeriod;							// us
+
+	uint8_t* RawBuffer;
+	float* Samples;
+	float* HalfPeriods;							// time between the zero crossings (us)
+	int HalfPeriodCount;
+	int HalfPeriodIndex;
+
+	double BufferPosition;					// sample position of the first sample of the buffer
+	float FilteredSample;
+	float LowpassRate;
+	float DCLevel;
+	float DCRate;
+	float Envelope;
+	float EnvelopeDecay;
+	float PreviousSample;
+	bool High;
+	double CrossingCandidate;				// interpolated sample position of the last sign change
+	double LastCrossing;						// sample position of the last detected zero crossing
+} WaveReader;
+
+// Decoded tape block
+typedef struct
+{
+	TapeBlockHeaderType Header;
+	uint8_t Data[TAPE_MAX_SECTOR_COUNT * TAPE_SECTOR_LENGTH];
+	int Length;
+	int CRCErrorCount;
+	bool EOFFound;
+} TapeBlock;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static bool OpenWaveFile(WaveReader* out_reader, wchar_t* in_file_name);
+static void CloseWaveFile(WaveReader* inout_reader);
+static bool ReadHalfPeriod(WaveReader* inout_reader, float* out_half_period);
+static void ConvertSamples(WaveReader* inout_reader, int in_sample_count);
+static void DemodulateSamples(WaveReader* inout_reader, int in_sample_count);
+static bool FindSync(WaveReader* inout_reader, float* out_leading_period);
+static bool DecodeByte(WaveReader* inout_reader, float in_leading_period, uint8_t* out_byte);
+static bool DecodeBlock(WaveReader* inout_reader, float in_leading_period, TapeBlock* out_block);
+static uint16_t UpdateCRC(uint16_t in_crc, uint8_t in_data);
+static void GetCASFileName(wchar_t* out_file_name, wchar_t* in_directory, char* in_tvc_file_name, wchar_t (*in_file_names)[MAX_PATH_LENGTH], int in_file_count);
+static bool WriteTapeCASFile(wchar_t* in_file_name, TapeBlockHeaderType* in_block_header, CASProgramFileHeaderType* in_program_header, uint8_t* in_data);
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes the files of a tape recording and saves them as CAS files into the given
+// directory (file names are taken from the tape). Damaged files are reported and
+// skipped, returns false only if the recording can't be read or a file can't be written.
+bool TapeDecodeWaveFile(wchar_t* in_wave_file_name, wchar_t* in_cas_directory, int in_max_file_count, wchar_t (*out_file_names)[MAX_PATH_LENGTH], int* out_file_count)
+{
+	WaveReader reader;
+	TapeBlock* block;
+	TapeBlockHeaderType file_header;
+	CASProgramFileHeaderType program_header;
+	char tvc_file_name[MAX_TVC_FILE_NAME_LENGTH + 1];
+	int name_length;
+	bool header_found = false;
+	float leading_period;
+	double position;
+	double recording_length;
+	double decode_time;
+	int error_count = 0;
+	LARGE_INTEGER start_time;
+	LARGE_INTEGER end_time;
+	LARGE_INTEGER frequency;
+	bool success = true;
+
+	*out_file_count = 0;
+
+	if (!OpenWaveFile(&reader, in_wave_file_name))
+		return false;
+
+	if (!CreateDirectoryW(in_cas_directory, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		fwprintf(stderr, L"\nCan't create directory: %s", in_cas_directory);
+		CloseWaveFile(&reader);
+		return false;
+	}
+
+	block = (TapeBlock*)malloc(sizeof(TapeBlock));
+	if (block == NULL)
+	{
+		fprintf(stderr, "Error: Insufficient memory\n");
+		exit(1);
+	}
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start_time);
+
+	while (success && FindSync(&reader, &leading_period))
+	{
+		position = reader.LastCrossing / reader.SampleRate;
+
+		if (!DecodeBlock(&reader, leading_period, block))
+		{
+			fwprintf(stdout, L"\n  %3d:%02d Invalid block", (int)position / 60, (int)position % 60);
+			error_count++;
+			continue;
+		}
+
+		if (block->Header.BlockType == TAPE_BLOCK_TYPE_HEADER)
+		{
+			// header block: file name and program header
+			name_length = block->Data[0];
+			header_found = (block->CRCErrorCount == 0 && 1 + name_length + (int)sizeof(program_header) <= block->Length);
+
+			if (header_found)
+			{
+				memcpy(&program_header, block->Data + 1 + name_length, sizeof(program_header));
+				header_found = CASCheckHeaderValidity(&program_header);
+			}
+
+			if (!header_found)
+			{
+				fwprintf(stdout, L"\n  %3d:%02d Damaged file header", (int)position / 60, (int)position % 60);
+				error_count++;
+				continue;
+			}
+
+			if (name_length > MAX_TVC_FILE_NAME_LENGTH)
+				name_length = MAX_TVC_FILE_NAME_LENGTH;
+
+			memcpy(tvc_file_name, block->Data + 1, name_length);
+			tvc_file_name[name_length] = '\0';
+			file_header = block->Header;
+		}
+		else
+		{
+			// data block of the last header
+			if (!header_found)
+			{
+				fwprintf(stdout, L"\n  %3d:%02d Data block without file header", (int)position / 60, (int)position % 60);
+				error_count++;
+				continue;
+			}
+
+			header_found = false;
+
+			if (file_header.FileType != CASBLOCKHDR_FILE_UNBUFFERED)
+			{
+				fwprintf(stdout, L"\n  %3d:%02d Buffered file is skipped", (int)position / 60, (int)position % 60);
+				continue;
+			}
+
+			if (block->CRCErrorCount > 0 || !block->EOFFound || block->Length < program_header.FileLength)
+			{
+				fwprintf(stdout, L"\n  %3d:%02d Damaged file (%d CRC errors, %d of %d bytes)", (int)position / 60, (int)position % 60,
+					block->CRCErrorCount, block->Length, program_header.FileLength);
+				error_count++;
+				continue;
+			}
+
+			if (*out_file_count >= in_max_file_count)
+			{
+				fwprintf(stderr, L"\nToo many files on the tape (maximum %d)!", in_max_file_count);
+				success = false;
+				break;
+			}
+
+			GetCASFileName(out_file_names[*out_file_count], in_cas_directory, tvc_file_name, out_file_names, *out_file_count);
+			success = WriteTapeCASFile(out_file_names[*out_file_count], &file_header, &program_header, block->Data);
+
+			if (success)
+			{
+				fwprintf(stdout, L"\n  %3d:%02d %s (%d bytes)", (int)position / 60, (int)position % 60, out_file_names[*out_file_count], program_header.FileLength);
+				(*out_file_count)++;
+			}
+		}
+	}
+
+	QueryPerformanceCounter(&end_time);
+
+	recording_length = reader.BufferPosition / reader.SampleRate;
+	decode_time = (double)(end_time.QuadPart - start_time.QuadPart) * 1000.0 / frequency.QuadPart;
+
+	fwprintf(stdout, L"\n  %d files decoded, %d errors, %.1f s recording in %.0f ms", *out_file_count, error_count, recording_length, decode_time);
+	if (decode_time > 0)
+		fwprintf(stdout, L" (%.0f times real time)", recording_length * 1000.0 / decode_time);
+
+	free(block);
+	CloseWaveFile(&reader);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Opens the recording and reads the format (8 or 16 bit PCM, first channel is used)
+static bool OpenWaveFile(WaveReader* out_reader, wchar_t* in_file_name)
+{
+	char riff_type[4];
+	WaveChunkHeaderType chunk_header;
+	WaveFormatType format;
+	bool format_found = false;
+	bool success = true;
+
+	memset(out_reader, 0, sizeof(WaveReader));
+
+	if (_wfopen_s(&out_reader->File, in_file_name, L"rb") != 0 || out_reader->File == NULL)
+	{
+		fwprintf(stderr, L"\nCan't open file: %s", in_file_name);
+		return false;
+	}
+
+	ReadBlock(out_reader->File, &chunk_header, sizeof(chunk_header), &success);
+	ReadBlock(out_reader->File, riff_type, sizeof(riff_type), &success);
+	success = success && memcmp(chunk_header.ID, "RIFF", 4) == 0 && memcmp(riff_type, "WAVE", 4) == 0;
+
+	// find format and data chunks
+	while (success)
+	{
+		ReadBlock(out_reader->File, &chunk_header, sizeof(chunk_header), &success);
+		if (!success)
+			break;
+
+		if (memcmp(chunk_header.ID, "fmt ", 4) == 0 && chunk_header.Length >= sizeof(format))
+		{
+			ReadBlock(out_reader->File, &format, sizeof(format), &success);
+			chunk_header.Length -= sizeof(format);
+			format_found = true;
+		}
+		else if (memcmp(chunk_header.ID, "data", 4) == 0)
+		{
+			out_reader->RemainingBytes = chunk_header.Length;
+			break;
+		}
+
+		// chunks are word aligned
+		if (fseek(out_reader->File, chunk_header.Length + (chunk_header.Length & 1), SEEK_CUR) != 0)
+			success = false;
+	}
+
+	if (success && (!format_found || (format.FormatTag != WAVE_FORMAT_PCM_TAG && format.FormatTag != WAVE_FORMAT_EXTENSIBLE_TAG) ||
+		(format.BitsPerSample != 8 && format.BitsPerSample != 16) || format.ChannelCount == 0 || format.SampleRate < TAPE_MIN_SAMPLE_RATE))
+	{
+		fwprintf(stderr, L"\nUnsupported wave format (8 or 16 bit PCM is required): %s", in_file_name);
+		fclose(out_reader->File);
+		return false;
+	}
+
+	if (!success)
+	{
+		fwprintf(stderr, L"\nInvalid wave file: %s", in_file_name);
+		fclose(out_reader->File);
+		return false;
+	}
+
+	out_reader->ChannelCount = format.ChannelCount;
+	out_reader->BytesPerSample = format.BitsPerSample / 8;
+	out_reader->SampleRate = format.SampleRate;
+	out_reader->SamplePeriod = 1000000.0f / format.SampleRate;
+
+	out_reader->RawBuffer = (uint8_t*)malloc(TAPE_READ_BUFFER_SAMPLES * out_reader->ChannelCount * out_reader->BytesPerSample);
+	out_reader->Samples = (float*)malloc(TAPE_READ_BUFFER_SAMPLES * sizeof(float));
+	out_reader->HalfPeriods = (float*)malloc(TAPE_READ_BUFFER_SAMPLES * sizeof(float));
+	if (out_reader->RawBuffer == NULL || out_reader->Samples == NULL || out_reader->HalfPeriods == NULL)
+	{
+		fprintf(stderr, "Error: Insufficient memory\n");
+		exit(1);
+	}
+
+	// detector state
+	out_reader->LowpassRate = 1.0f - expf(-2 * 3.14159265f * TAPE_LOWPASS_FREQUENCY / format.SampleRate);
+	out_reader->DCRate = 1.0f / (TAPE_DC_TIME_CONSTANT * format.SampleRate);
+	out_reader->EnvelopeDecay = 1.0f - 1.0f / (TAPE_ENVELOPE_TIME_CONSTANT * format.SampleRate);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Closes the recording and releases the buffers
+static void CloseWaveFile(WaveReader* inout_reader)
+{
+	fclose(inout_reader->File);
+
+	free(inout_reader->RawBuffer);
+	free(inout_reader->Samples);
+	free(inout_reader->HalfPeriods);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the next half period of the signal (the recording is read and demodulated
+// in buffers), returns false at the end of the recording
+static bool ReadHalfPeriod(WaveReader* inout_reader, float* out_half_period)
+{
+	size_t frame_length;
+	size_t read_length;
+	int sample_count;
+
+	while (inout_reader->HalfPeriodIndex >= inout_reader->HalfPeriodCount)
+	{
+		if (inout_reader->RemainingBytes == 0)
+			return false;
+
+		frame_length = (size_t)inout_reader->ChannelCount * inout_reader->BytesPerSample;
+		read_length = TAPE_READ_BUFFER_SAMPLES * frame_length;
+		if (read_length > inout_reader->RemainingBytes)
+			read_length = inout_reader->RemainingBytes;
+
+		read_length = fread(inout_reader->RawBuffer, 1, read_length, inout_reader->File);
+		sample_count = (int)(read_length / frame_length);
+		if (sample_count == 0)
+		{
+			inout_reader->RemainingBytes = 0;
+			return false;
+		}
+
+		inout_reader->RemainingBytes -= (uint32_t)read_length;
+
+		ConvertSamples(inout_reader, sample_count);
+		DemodulateSamples(inout_reader, sample_count);
+	}
+
+	*out_half_period = inout_reader->HalfPeriods[inout_reader->HalfPeriodIndex++];
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Converts the first channel of the read buffer to -1..1 samples
+static void ConvertSamples(WaveReader* inout_reader, int in_sample_count)
+{
+	int stride = inout_reader->ChannelCount * inout_reader->BytesPerSample;
+	uint8_t* raw = inout_reader->RawBuffer;
+	float* samples = inout_reader->Samples;
+	int i;
+
+	if (inout_reader->BytesPerSample == 1)
+	{
+		for (i = 0; i < in_sample_count; i++)
+			samples[i] = ((int)raw[i * stride] - 128) * (1.0f / 128);
+	}
+	else
+	{
+		for (i = 0; i < in_sample_count; i++)
+			samples[i] = (int16_t)(raw[i * stride] | (raw[i * stride + 1] << 8)) * (1.0f / 32768);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Zero crossing detector of the buffer. The noise is filtered, the DC level is removed, a crossing is
+// accepted when the signal exceeds the hysteresis level on the other side and
+// its position is interpolated between the samples of the sign change.
+static void DemodulateSamples(WaveReader* inout_reader, int in_sample_count)
+{
+	float* samples = inout_reader->Samples;
+	float* half_periods = inout_reader->HalfPeriods;
+	float filtered = inout_reader->FilteredSample;
+	float dc_level = inout_reader->DCLevel;
+	float envelope = inout_reader->Envelope;
+	float previous = inout_reader->PreviousSample;
+	bool high = inout_reader->High;
+	double candidate = inout_reader->CrossingCandidate;
+	double last_crossing = inout_reader->LastCrossing;
+	double position = inout_reader->BufferPosition;
+	float sample;
+	float magnitude;
+	float hysteresis;
+	int count = 0;
+	int i;
+
+	for (i = 0; i < in_sample_count; i++)
+	{
+		filtered += (samples[i] - filtered) * inout_reader->LowpassRate;
+		dc_level += (filtered - dc_level) * inout_reader->DCRate;
+		sample = filtered - dc_level;
+
+		magnitude = fabsf(sample);
+		envelope = (magnitude > envelope) ? magnitude : envelope * inout_reader->EnvelopeDecay;
+		hysteresis = envelope * TAPE_HYSTERESIS_RATIO;
+		if (hysteresis < TAPE_MIN_LEVEL)
+			hysteresis = TAPE_MIN_LEVEL;
+
+		// sign change
+		if ((sample >= 0) != (previous >= 0))
+			candidate = position + i - 1 + previous / (previous - sample);
+
+		if ((high && sample < -hysteresis) || (!high && sample > hysteresis))
+		{
+			high = !high;
+			half_periods[count++] = (float)(candidate - last_crossing) * inout_reader->SamplePeriod;
+			last_crossing = candidate;
+		}
+
+		previous = sample;
+	}
+
+	inout_reader->FilteredSample = filtered;
+	inout_reader->DCLevel = dc_level;
+	inout_reader->Envelope = envelope;
+	inout_reader->PreviousSample = previous;
+	inout_reader->High = high;
+	inout_reader->CrossingCandidate = candidate;
+	inout_reader->LastCrossing = last_crossing;
+	inout_reader->BufferPosition = position + in_sample_count;
+	inout_reader->HalfPeriodCount = count;
+	inout_reader->HalfPeriodIndex = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds the next leading tone and its sync period, the data starts after the sync.
+// Periods are measured on two consecutive half periods, so asymmetric signals
+// and both polarities are handled.
+static bool FindSync(WaveReader* inout_reader, float* out_leading_period)
+{
+	float half_period;
+	float previous_half_period = 0;
+	float period;
+	float average = 0;
+	int count = 0;
+	bool deviation = false;
+
+	while (ReadHalfPeriod(inout_reader, &half_period))
+	{
+		period = previous_half_period + half_period;
+		previous_half_period = half_period;
+
+		// sync period is longer than any other period
+		if (count >= TAPE_MIN_LEADING_LENGTH && period > average * TAPE_SYNC_THRESHOLD)
+		{
+			*out_leading_period = average;
+			return true;
+		}
+
+		// the period which contains the first half of the sync is accepted once
+		if (count > 0 && fabsf(period - average) > average * TAPE_LEADING_TOLERANCE)
+		{
+			if (count >= TAPE_MIN_LEADING_LENGTH && !deviation)
+			{
+				deviation = true;
+				continue;
+			}
+
+			count = 0;
+		}
+
+		deviation = false;
+
+		// average of the leading tone (follows the speed changes)
+		if (count == 0)
+			average = period;
+		else
+			average += (period - average) / ((count < TAPE_LEADING_AVERAGE_LENGTH) ? count + 1 : TAPE_LEADING_AVERAGE_LENGTH);
+
+		count++;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes one byte (bits are stored from the LSB, one period per bit)
+static bool DecodeByte(WaveReader* inout_reader, float in_leading_period, uint8_t* out_byte)
+{
+	float first_half;
+	float second_half;
+	float period;
+	uint8_t data = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		if (!ReadHalfPeriod(inout_reader, &first_half) || !ReadHalfPeriod(inout_reader, &second_half))
+			return false;
+
+		// signal is lost
+		period = first_half + second_half;
+		if (period > in_leading_period * TAPE_SYNC_THRESHOLD)
+			return false;
+
+		data >>= 1;
+		if (period < in_leading_period * TAPE_BIT_THRESHOLD)
+			data |= 0x80;
+	}
+
+	*out_byte = data;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes the block after the sync. Every sector contains its number, length,
+// data, EOF flag and the CRC of the bytes since the previous CRC (the first CRC
+// includes the block header). Sectors with CRC error are decoded too.
+static bool DecodeBlock(WaveReader* inout_reader, float in_leading_period, TapeBlock* out_block)
+{
+	uint8_t* header = (uint8_t*)&out_block->Header;
+	uint8_t sector_header[2];
+	uint8_t crc_bytes[2];
+	uint8_t eof_flag;
+	uint16_t crc = 0;
+	int sector_count;
+	int sector_length;
+	int sector;
+	int i;
+
+	out_block->Length = 0;
+	out_block->CRCErrorCount = 0;
+	out_block->EOFFound = false;
+
+	for (i = 0; i < (int)sizeof(TapeBlockHeaderType); i++)
+	{
+		if (!DecodeByte(inout_reader, in_leading_period, &header[i]))
+			return false;
+
+		crc = UpdateCRC(crc, header[i]);
+	}
+
+	if (out_block->Header.Zero != 0 || out_block->Header.Magic != TAPE_BLOCK_MAGIC ||
+		(out_block->Header.BlockType != TAPE_BLOCK_TYPE_HEADER && out_block->Header.BlockType != TAPE_BLOCK_TYPE_DATA))
+		return false;
+
+	sector_count = (out_block->Header.SectorCount == 0) ? TAPE_MAX_SECTOR_COUNT : out_block->Header.SectorCount;
+
+	for (sector = 0; sector < sector_count && !out_block->EOFFound; sector++)
+	{
+		// sector number and length
+		for (i = 0; i < 2; i++)
+		{
+			if (!DecodeByte(inout_reader, in_leading_period, &sector_header[i]))
+				return false;
+
+			crc = UpdateCRC(crc, sector_header[i]);
+		}
+
+		sector_length = (sector_header[1] == 0) ? TAPE_SECTOR_LENGTH : sector_header[1];
+
+		// sector data
+		for (i = 0; i < sector_length; i++)
+		{
+			if (!DecodeByte(inout_reader, in_leading_period, &out_block->Data[out_block->Length + i]))
+				return false;
+
+			crc = UpdateCRC(crc, out_block->Data[out_block->Length + i]);
+		}
+
+		out_block->Length += sector_length;
+
+		// EOF flag and CRC
+		if (!DecodeByte(inout_reader, in_leading_period, &eof_flag))
+			return false;
+
+		crc = UpdateCRC(crc, eof_flag);
+
+		if (!DecodeByte(inout_reader, in_leading_period, &crc_bytes[0]) || !DecodeByte(inout_reader, in_leading_period, &crc_bytes[1]))
+			return false;
+
+		if ((crc_bytes[0] | (crc_bytes[1] << 8)) != crc)
+			out_block->CRCErrorCount++;
+
+		crc = 0;
+		out_block->EOFFound = (eof_flag == TAPE_SECTOR_EOF);
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds a byte to the CRC (in the bit order of the tape)
+static uint16_t UpdateCRC(uint16_t in_crc, uint8_t in_data)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		if (((in_crc >> 15) ^ in_data) & 0x01)
+			in_crc = (uint16_t)((in_crc << 1) ^ TAPE_CRC_POLYNOMIAL);
+		else
+			in_crc = (uint16_t)(in_crc << 1);
+
+		in_data >>= 1;
+	}
+
+	return in_crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the CAS file name from the tape file name, a number is appended if the
+// name is used by a previous file of the recording
+static void GetCASFileName(wchar_t* out_file_name, wchar_t* in_directory, char* in_tvc_file_name, wchar_t (*in_file_names)[MAX_PATH_LENGTH], int in_file_count)
+{
+	wchar_t name[MAX_PATH_LENGTH];
+	int suffix = 1;
+	int i;
+
+	TVCToPCFilename(name, in_tvc_file_name);
+	swprintf_s(out_file_name, MAX_PATH_LENGTH, L"%s%s.CAS", in_directory, name);
+
+	for (i = 0; i < in_file_count && suffix < TAPE_MAX_NAME_SUFFIX; i++)
+	{
+		if (CompareFilenames(out_file_name, in_file_names[i]) == 0)
+		{
+			suffix++;
+			swprintf_s(out_file_name, MAX_PATH_LENGTH, L"%s%s_%d.CAS", in_directory, name, suffix);
+			i = -1;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes the decoded file in CAS format
+static bool WriteTapeCASFile(wchar_t* in_file_name, TapeBlockHeaderType* in_block_header, CASProgramFileHeaderType* in_program_header, uint8_t* in_data)
+{
+	FILE* cas_file = NULL;
+	CASUPMHeaderType upm_header;
+	int file_length;
+	bool success = true;
+
+	if (_wfopen_s(&cas_file, in_file_name, L"wb") != 0 || cas_file == NULL)
+	{
+		fwprintf(stderr, L"\nCan't create file: %s", in_file_name);
+		return false;
+	}
+
+	file_length = sizeof(upm_header) + sizeof(CASProgramFileHeaderType) + in_program_header->FileLength;
+
+	memset(&upm_header, 0, sizeof(upm_header));
+	upm_header.FileType = in_block_header->FileType;
+	upm_header.CopyProtect = in_block_header->CopyProtect;
+	upm_header.BlockNumber = (uint16_t)(file_length / CAS_BLOCK_LENGTH);
+	upm_header.LastBlockBytes = (uint8_t)(file_length % CAS_BLOCK_LENGTH);
+
+	WriteBlock(cas_file, &upm_header, sizeof(upm_header), &success);
+	WriteBlock(cas_file, in_program_header, sizeof(CASProgramFileHeaderType), &success);
+	WriteBlock(cas_file, in_data, in_program_header->FileLength, &success);
+
+	fclose(cas_file);
+
+	if (!success)
+		fwprintf(stderr, L"\nFile write error: %s", in_file_name);
+
+	return success;
+}
@@ -0,0 +1,39 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Video memory filter (XOR delta of the screen rows)                        */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "VideoFilter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the filtered copy of the data. Every byte after the first row is XORed
+// by the byte above it (VIDEO_ROW_LENGTH bytes earlier), vertically repeated pixels
+// become zero bytes which are matched at short offsets. The loader (DECODE_ROW_DELTA)
+// restores the rows from the top to the bottom. Returns NULL if there is not enough memory.
+uint8_t* EncodeVideoRowDelta(uint8_t* in_data, int in_length)
+{
+	uint8_t* filtered_data;
+	int i;
+
+	filtered_data = (uint8_t*)malloc(in_length);
+	if (filtered_data == NULL)
+		return NULL;
+
+	memcpy(filtered_data, in_data, in_length);
+
+	for (i = VIDEO_ROW_LENGTH; i < in_length; i++)
+		filtered_data[i] ^= in_data[i - VIDEO_ROW_LENGTH];
+
+	return filtered_data;
+}
@@ -28,108 +28,114 @@
 
 #include "ZX7Compress.h"
 
-unsigned char* output_data;
-size_t output_index;
-size_t bit_index;
-int bit_mask;
-
-void write_byte(int value) {
-    output_data[output_index++] = value;
+/* output state is kept on the stack, so files can be compressed concurrently */
+typedef struct {
+    unsigned char* output_data;
+    size_t output_index;
+    size_t bit_index;
+    int bit_mask;
+} Writer;
+
+static void write_byte(Writer *writer, int value) {
+    writer->output_data[writer->output_index++] = value;
 }
 
-void write_bit(int value) {
-    if (bit_mask == 0) {
-        bit_mask = 128;
-        bit_index = output_index;
-        write_byte(0);
+static void write_bit(Writer *writer, int value) {
+    if (writer->bit_mask == 0) {
+        writer->bit_mask = 128;
+        writer->bit_index = writer->output_index;
+        write_byte(writer, 0);
     }
     if (value > 0) {
-        output_data[bit_index] |= bit_mask;
+        writer->output_data[writer->bit_index] |= writer->bit_mask;
     }
-    bit_mask >>= 1;
+    writer->bit_mask >>= 1;
 }
 
-void write_elias_gamma(int value) {
+static void write_elias_gamma(Writer *writer, int value) {
     int i;
 
     for (i = 2; i <= value; i <<= 1) {
-        write_bit(0);
+        write_bit(writer, 0);
     }
     while ((i >>= 1) > 0) {
-        write_bit(value & i);
+        write_bit(writer, value & i);
     }
 }
 
-unsigned char *ZX7Compress(Optimal *optimal, unsigned char *input_data, size_t input_size, size_t *output_size) {
+unsigned char *ZX7Compress(Optimal *optimal, unsigned char *input_data, size_t input_size, int max_offset, size_t *output_size) {
+    Writer writer;
     size_t input_index;
     size_t input_prev;
     int offset1;
+    int offset_bits;
     int mask;
     int i;
 
+    offset_bits = offset_bits_of(max_offset);
+
     /* calculate and allocate output buffer */
     input_index = input_size-1;
-    *output_size = (optimal[input_index].bits+18+7)/8;
-    output_data = (unsigned char *)malloc(*output_size);
-    if (!output_data) {
-         fprintf(stderr, "Error: Insufficient memory\n");
-         exit(1);
+    *output_size = (optimal->bits[input_index]+18+7)/8;
+    writer.output_data = (unsigned char *)malloc(*output_size);
+    if (!writer.output_data) {
+         return NULL;
     }
 
-    /* un-reverse optimal sequence */
-    optimal[input_index].bits = 0;
+    /* un-reverse optimal sequence (bits of the path positions are replaced by the next position) */
+    optimal->bits[input_index] = 0;
     while (input_index > 0) {
-        input_prev = input_index - (optimal[input_index].len > 0 ? optimal[input_index].len : 1);
-        optimal[input_prev].bits = input_index;
+        input_prev = input_index - (optimal->len[input_index] > 0 ? optimal->len[input_index] : 1);
+        optimal->bits[input_prev] = (unsigned int)input_index;
         input_index = input_prev;
     }
 
-    output_index = 0;
-    bit_mask = 0;
+    writer.output_index = 0;
+    writer.bit_mask = 0;
 
     /* first byte is always literal */
-    write_byte(input_data[0]);
+    write_byte(&writer, input_data[0]);
 
     /* process remaining bytes */
-    while ((input_index = optimal[input_index].bits) > 0) {
-        if (optimal[input_index].len == 0) {
+    while ((input_index = optimal->bits[input_index]) > 0) {
+        if (optimal->len[input_index] == 0) {
 
             /* literal indicator */
-            write_bit(0);
+            write_bit(&writer, 0);
 
             /* literal value */
-            write_byte(input_data[input_index]);
+            write_byte(&writer, input_data[input_index]);
 
         } else {
 
             /* sequence indicator */
-            write_bit(1);
+            write_bit(&writer, 1);
 
             /* sequence length */
-            write_elias_gamma(optimal[input_index].len-1);
+            write_elias_gamma(&writer, optimal->len[input_index]-1);
 
             /* sequence offset */
-            offset1 = optimal[input_index].offset-1;
+            offset1 = optimal->offset[input_index]-1;
             if (offset1 < 128) {
-                write_byte(offset1);
+                write_byte(&writer, offset1);
             } else {
                 offset1 -= 128;
-                write_byte((offset1 & 127) | 128);
-                for (mask = 1024; mask > 127; mask >>= 1) {
-                    write_bit(offset1 & mask);
+                write_byte(&writer, (offset1 & 127) | 128);
+                for (mask = 64 << offset_bits; mask > 127; mask >>= 1) {
+                    write_bit(&writer, offset1 & mask);
                 }
             }
         }
     }
 
     /* sequence indicator */
-    write_bit(1);
+    write_bit(&writer, 1);
 
     /* end marker > MAX_LEN */
     for (i = 0; i < 16; i++) {
-        write_bit(0);
+        write_bit(&writer, 0);
     }
-    write_bit(1);
+    write_bit(&writer, 1);
 
-    return output_data;
+    return writer.output_data;
 }
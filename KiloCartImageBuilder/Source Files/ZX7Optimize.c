@@ -28,6 +28,9 @@
 
 #include "ZX7Compress.h"
 
+static Optimal* optimize_matches(MatchTable *table, size_t input_size, int max_offset, int prefer_long);
+static int add_candidate(MatchTable *table, int offset, size_t len);
+
 int elias_gamma_bits(int value) {
     int bits;
 
@@ -39,61 +42,169 @@ int elias_gamma_bits(int value) {
     return bits;
 }
 
-int count_bits(int offset, int len) {
-    return 1 + (offset > 128 ? 12 : 8) + elias_gamma_bits(len-1);
+/*
+ * Extra bits of the long offsets of the format which can store the offsets of
+ * the given window (windows up to 128 bytes don't use long offsets).
+ */
+int offset_bits_of(int max_offset) {
+    int offset_bits;
+
+    offset_bits = MIN_OFFSET_BITS;
+    while (offset_bits < MAX_OFFSET_BITS && MAX_OFFSET_OF(offset_bits) < max_offset) {
+        offset_bits++;
+    }
+    return offset_bits;
+}
+
+int count_bits(int offset, int len, int offset_bits) {
+    return 1 + (offset > 128 ? 8+offset_bits : 8) + elias_gamma_bits(len-1);
+}
+
+Optimal* ZX7Optimize(unsigned char *input_data, size_t input_size, int max_offset) {
+    return ZX7OptimizeRange(input_data, input_size, max_offset, 0, input_size);
+}
+
+/*
+ * Optimizes the [start, end) range of the input only. The parse starts after
+ * position start-1 (bits are counted from there), the preceding max_offset
+ * bytes are used only as match history.
+ */
+Optimal* ZX7OptimizeRange(unsigned char *input_data, size_t input_size, int max_offset, size_t start, size_t end) {
+    MatchTable *table;
+    Optimal *optimal;
+
+    table = ZX7FindMatches(input_data, input_size, max_offset, start, end);
+    if (!table) {
+        return NULL;
+    }
+
+    optimal = ZX7OptimizeMatches(table, input_size, max_offset);
+    ZX7FreeMatchTable(table);
+
+    return optimal;
 }
 
-Optimal* ZX7Optimize(unsigned char *input_data, size_t input_size) {
-    size_t *min;
-    size_t *max;
-    Match *matches;
-    Match *match_slots;
+/*
+ * Allocates the parse arrays of the given input size in one block. Returns
+ * NULL if the input is too long or there is not enough memory.
+ */
+Optimal* ZX7AllocateOptimal(size_t input_size) {
     Optimal *optimal;
-    Match *match;
+
+    if (input_size > MAX_INPUT_SIZE) {
+         return NULL;
+    }
+
+    optimal = (Optimal *)calloc(1, sizeof(Optimal) + input_size*(sizeof(unsigned int)+2*sizeof(unsigned short)));
+    if (!optimal) {
+         return NULL;
+    }
+
+    optimal->size = input_size;
+    optimal->bits = (unsigned int *)(optimal+1);
+    optimal->offset = (unsigned short *)(optimal->bits+input_size);
+    optimal->len = optimal->offset+input_size;
+
+    return optimal;
+}
+
+void ZX7FreeOptimal(Optimal *optimal) {
+    free(optimal);
+}
+
+static int add_candidate(MatchTable *table, int offset, size_t len) {
+    unsigned short *new_offset;
+    unsigned short *new_len;
+
+    if (table->count == table->capacity) {
+        new_offset = (unsigned short *)realloc(table->offset, table->capacity*2*sizeof(unsigned short));
+        if (!new_offset) {
+             return 0;
+        }
+        table->offset = new_offset;
+
+        new_len = (unsigned short *)realloc(table->len, table->capacity*2*sizeof(unsigned short));
+        if (!new_len) {
+             return 0;
+        }
+        table->len = new_len;
+
+        table->capacity *= 2;
+    }
+    table->offset[table->count] = (unsigned short)offset;
+    table->len[table->count] = (unsigned short)len;
+    table->count++;
+
+    return 1;
+}
+
+/*
+ * Collects the match candidates of the [start, end) range. Candidates don't
+ * depend on the parse therefore ranges can be processed independently (the
+ * preceding max_offset bytes are used as match history). Returns NULL if the
+ * input is too long or there is not enough memory.
+ */
+MatchTable* ZX7FindMatches(unsigned char *input_data, size_t input_size, int max_offset, size_t start, size_t end) {
+    unsigned int *min;
+    unsigned int *max;
+    unsigned short *heads;
+    unsigned short *chain;
+    unsigned short *link;
+    MatchTable *table;
     int match_index;
     int offset;
     size_t len;
     size_t best_len;
-    size_t bits;
     size_t i;
+    size_t history_start;
+    int failed;
+
+    if (input_size > MAX_INPUT_SIZE) {
+         return NULL;
+    }
 
-    /* allocate all data structures at once */
-    min = (size_t *)calloc(MAX_OFFSET+1, sizeof(size_t));
-    max = (size_t *)calloc(MAX_OFFSET+1, sizeof(size_t));
-    matches = (Match *)calloc(256*256, sizeof(Match));
-    match_slots = (Match *)calloc(input_size, sizeof(Match));
-    optimal = (Optimal *)calloc(input_size, sizeof(Optimal));
+    /* allocate all data structures at once (chains are position indexes, 0 is the end of the chain) */
+    min = (unsigned int *)calloc(max_offset+1, sizeof(unsigned int));
+    max = (unsigned int *)calloc(max_offset+1, sizeof(unsigned int));
+    heads = (unsigned short *)calloc(256*256, sizeof(unsigned short));
+    chain = (unsigned short *)calloc(input_size, sizeof(unsigned short));
+    table = (MatchTable *)calloc(1, sizeof(MatchTable));
 
-    if (!min || !max || !matches || !match_slots || !optimal) {
-         fprintf(stderr, "Error: Insufficient memory\n");
-         exit(1);
+    if (table) {
+        table->start = start;
+        table->end = end;
+        table->capacity = (end > start) ? (end-start)*2 : 1;
+        table->first = (unsigned int *)calloc(end-start+1, sizeof(unsigned int));
+        table->offset = (unsigned short *)malloc(table->capacity*sizeof(unsigned short));
+        table->len = (unsigned short *)malloc(table->capacity*sizeof(unsigned short));
     }
 
-    /* first byte is always literal */
-    optimal[0].bits = 8;
+    failed = !min || !max || !heads || !chain || !table || !table->first || !table->offset || !table->len;
+
+    /* history is walked to build the match chains but its candidates are not stored */
+    history_start = (start > (size_t)max_offset) ? start - max_offset - 1 : 0;
 
     /* process remaining bytes */
-    for (i = 1; i < input_size; i++) {
+    for (i = history_start+1; i < end && !failed; i++) {
+
+        if (i >= start) {
+            table->first[i-start] = (unsigned int)table->count;
+        }
 
-        optimal[i].bits = optimal[i-1].bits + 9;
         match_index = input_data[i-1] << 8 | input_data[i];
         best_len = 1;
-        for (match = &matches[match_index]; match->next != NULL && best_len < MAX_LEN; match = match->next) {
-            offset = i - match->next->index;
-            if (offset > MAX_OFFSET) {
-                match->next = NULL;
+        for (link = &heads[match_index]; *link != 0 && best_len < MAX_LEN; link = &chain[*link]) {
+            table->chain_steps++;
+            offset = (int)(i - *link);
+            if (offset > max_offset) {
+                *link = 0;
                 break;
             }
 
             for (len = 2; len <= MAX_LEN; len++) {
+                table->extension_steps++;
                 if (len > best_len) {
                     best_len = len;
-                    bits = optimal[i-len].bits + count_bits(offset, len);
-                    if (optimal[i].bits > bits) {
-                        optimal[i].bits = bits;
-                        optimal[i].offset = offset;
-                        optimal[i].len = len;
-                    }
                 } else if (i+1 == max[offset]+len && max[offset] != 0) {
                     len = i-min[offset];
                     if (len > best_len) {
@@ -104,17 +215,117 @@ Optimal* ZX7Optimize(unsigned char *input_data, size_t input_size) {
                     break;
                 }
             }
-            min[offset] = i+1-len;
-            max[offset] = i;
+            min[offset] = (unsigned int)(i+1-len);
+            max[offset] = (unsigned int)i;
+
+            /* lengths between the previous best length and this one are new candidates */
+            if (i >= start && (table->count == table->first[i-start] || table->len[table->count-1] < best_len)) {
+                if (!add_candidate(table, offset, best_len)) {
+                    failed = 1;
+                    break;
+                }
+            }
+        }
+        chain[i] = heads[match_index];
+        heads[match_index] = (unsigned short)i;
+    }
+
+    free(chain);
+    free(heads);
+    free(max);
+    free(min);
+
+    if (failed) {
+        if (table) {
+            ZX7FreeMatchTable(table);
         }
-        match_slots[i].index = i;
-        match_slots[i].next = matches[match_index].next;
-        matches[match_index].next = &match_slots[i];
+        return NULL;
+    }
+
+    table->first[end-start] = (unsigned int)table->count;
+
+    return table;
+}
+
+/*
+ * Creates the optimal parse of the range of the match table. Only the
+ * candidates up to max_offset are used (the offsets of a position's candidates
+ * are increasing), therefore a table of a larger window can be parsed for
+ * every format which has a smaller window.
+ */
+Optimal* ZX7OptimizeMatches(MatchTable *table, size_t input_size, int max_offset) {
+    return optimize_matches(table, input_size, max_offset, 0);
+}
+
+/*
+ * Same as ZX7OptimizeMatches but the longest sequence is selected from the
+ * equal cost ones (the parse has the same size with fewer sequences).
+ */
+Optimal* ZX7OptimizeMatchesLongest(MatchTable *table, size_t input_size, int max_offset) {
+    return optimize_matches(table, input_size, max_offset, 1);
+}
+
+static Optimal* optimize_matches(MatchTable *table, size_t input_size, int max_offset, int prefer_long) {
+    Optimal *optimal;
+    unsigned int *bits;
+    unsigned int *first;
+    unsigned int candidate;
+    unsigned int last_candidate;
+    unsigned int offset;
+    unsigned int cost;
+    size_t len;
+    size_t max_len;
+    size_t i;
+    int offset_bits;
+
+    offset_bits = offset_bits_of(max_offset);
+    optimal = ZX7AllocateOptimal(input_size);
+    if (!optimal) {
+        return NULL;
+    }
+    bits = optimal->bits;
+
+    /* history is not part of the parse */
+    for (i = 0; i < table->start; i++) {
+        bits[i] = (i + 1 == table->start) ? 0 : RANGE_HISTORY_BITS;
     }
 
-    /* save time by releasing the largest block only, the O.S. will clean everything else later */
-    free(match_slots);
+    /* first byte is always literal */
+    i = table->start;
+    if (i == 0) {
+        bits[0] = 8;
+        i++;
+    }
+
+    first = table->first - table->start;
+    for (; i < table->end; i++) {
+        bits[i] = bits[i-1] + 9;
+
+        len = 2;
+        last_candidate = first[i+1];
+        for (candidate = first[i]; candidate < last_candidate; candidate++) {
+            offset = table->offset[candidate];
+            if (offset > (unsigned int)max_offset) {
+                break;
+            }
+            max_len = table->len[candidate];
+            for (; len <= max_len; len++) {
+                cost = bits[i-len] + count_bits(offset, (int)len, offset_bits);
+                if (bits[i] > cost || (prefer_long && bits[i] == cost && optimal->len[i] != 0)) {
+                    bits[i] = cost;
+                    optimal->offset[i] = (unsigned short)offset;
+                    optimal->len[i] = (unsigned short)len;
+                }
+            }
+        }
+    }
 
     return optimal;
 }
 
+void ZX7FreeMatchTable(MatchTable *table) {
+    free(table->first);
+    free(table->offset);
+    free(table->len);
+    free(table);
+}
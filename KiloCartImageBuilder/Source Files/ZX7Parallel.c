@@ -0,0 +1,229 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Parallel match finding for the ZX7 compressor                             */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Windows.h>
+#include "ZX7Parallel.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	unsigned char* InputData;
+	size_t InputSize;
+	int MaxOffset;
+	size_t Start;			// First position of the chunk
+	size_t End;				// First position of the next chunk
+	MatchTable* Matches;
+} ChunkInfo;
+
+typedef struct
+{
+	ZX7ParallelTask Task;
+	void* Context;
+} TaskInfo;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static void ChunkTask(void* inout_context);
+static DWORD WINAPI TaskThread(LPVOID in_param);
+static MatchTable* MergeMatchTables(ChunkInfo* in_chunks, int in_chunk_count, size_t in_input_size);
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates the exact optimal parse. Match candidates are collected on several
+// threads (each thread processes a chunk of the input), the parse is created
+// from the merged candidate table on the calling thread.
+Optimal* ZX7OptimizeParallel(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, int in_thread_count)
+{
+	MatchTable* matches;
+	Optimal* optimal;
+
+	matches = ZX7FindMatchesParallel(in_input_data, in_input_size, in_max_offset, in_thread_count);
+	if (matches == NULL)
+		return NULL;
+
+	optimal = ZX7OptimizeMatches(matches, in_input_size, in_max_offset);
+
+	ZX7FreeMatchTable(matches);
+
+	return optimal;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Collects match candidates of the whole input on several threads (returns NULL
+// if there is not enough memory)
+MatchTable* ZX7FindMatchesParallel(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, int in_thread_count)
+{
+	ChunkInfo chunks[ZX7_MAX_CHUNK_COUNT];
+	int chunk_count;
+	int i;
+
+	// determine number of chunks
+	chunk_count = (int)(in_input_size / ZX7_MIN_CHUNK_LENGTH);
+	if (chunk_count > in_thread_count)
+		chunk_count = in_thread_count;
+	if (chunk_count > ZX7_MAX_CHUNK_COUNT)
+		chunk_count = ZX7_MAX_CHUNK_COUNT;
+
+	if (chunk_count < 2)
+		return ZX7FindMatches(in_input_data, in_input_size, in_max_offset, 0, in_input_size);
+
+	// find matches in parallel
+	for (i = 0; i < chunk_count; i++)
+	{
+		chunks[i].InputData = in_input_data;
+		chunks[i].InputSize = in_input_size;
+		chunks[i].MaxOffset = in_max_offset;
+		chunks[i].Start = in_input_size * i / chunk_count;
+		chunks[i].End = in_input_size * (i + 1) / chunk_count;
+		chunks[i].Matches = NULL;
+	}
+
+	ZX7RunParallel(ChunkTask, chunks, sizeof(ChunkInfo), chunk_count);
+
+	return MergeMatchTables(chunks, chunk_count, in_input_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs the task once for each context (contexts are stored in an array with
+// the given element size), every run is started on its own thread. Returns
+// when all runs are finished.
+void ZX7RunParallel(ZX7ParallelTask in_task, void* inout_contexts, size_t in_context_size, int in_count)
+{
+	TaskInfo tasks[ZX7_MAX_THREAD_COUNT];
+	HANDLE threads[ZX7_MAX_THREAD_COUNT];
+	int i;
+
+	if (in_count > ZX7_MAX_THREAD_COUNT)
+		in_count = ZX7_MAX_THREAD_COUNT;
+
+	for (i = 0; i < in_count; i++)
+	{
+		tasks[i].Task = in_task;
+		tasks[i].Context = (unsigned char*)inout_contexts + i * in_context_size;
+
+		threads[i] = CreateThread(NULL, 0, TaskThread, &tasks[i], 0, NULL);
+		if (threads[i] == NULL)
+		{
+			// no more threads, run task on this thread
+			in_task(tasks[i].Context);
+		}
+	}
+
+	for (i = 0; i < in_count; i++)
+	{
+		if (threads[i] != NULL)
+		{
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the number of processors (the default number of compression threads)
+int ZX7GetProcessorCount(void)
+{
+	SYSTEM_INFO system_info;
+
+	GetSystemInfo(&system_info);
+
+	return (int)system_info.dwNumberOfProcessors;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Thread entry of a parallel task
+static DWORD WINAPI TaskThread(LPVOID in_param)
+{
+	TaskInfo* task = (TaskInfo*)in_param;
+
+	task->Task(task->Context);
+
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds matches of one chunk
+static void ChunkTask(void* inout_context)
+{
+	ChunkInfo* chunk = (ChunkInfo*)inout_context;
+
+	chunk->Matches = ZX7FindMatches(chunk->InputData, chunk->InputSize, chunk->MaxOffset, chunk->Start, chunk->End);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Concatenates the candidate tables of the chunks (chunk tables are released)
+static MatchTable* MergeMatchTables(ChunkInfo* in_chunks, int in_chunk_count, size_t in_input_size)
+{
+	MatchTable* table = NULL;
+	MatchTable* chunk_table;
+	size_t count = 0;
+	size_t i;
+	int chunk;
+
+	for (chunk = 0; chunk < in_chunk_count; chunk++)
+	{
+		if (in_chunks[chunk].Matches == NULL)
+			break;
+
+		count += in_chunks[chunk].Matches->count;
+	}
+
+	if (chunk == in_chunk_count)
+		table = (MatchTable*)calloc(1, sizeof(MatchTable));
+	if (table != NULL)
+	{
+		table->start = 0;
+		table->end = in_input_size;
+		table->capacity = (count > 0) ? count : 1;
+		table->first = (unsigned int*)calloc(in_input_size + 1, sizeof(unsigned int));
+		table->offset = (unsigned short*)malloc(table->capacity * sizeof(unsigned short));
+		table->len = (unsigned short*)malloc(table->capacity * sizeof(unsigned short));
+	}
+
+	if (table == NULL || table->first == NULL || table->offset == NULL || table->len == NULL)
+	{
+		for (chunk = 0; chunk < in_chunk_count; chunk++)
+		{
+			if (in_chunks[chunk].Matches != NULL)
+				ZX7FreeMatchTable(in_chunks[chunk].Matches);
+		}
+
+		if (table != NULL)
+			ZX7FreeMatchTable(table);
+
+		return NULL;
+	}
+
+	for (chunk = 0; chunk < in_chunk_count; chunk++)
+	{
+		chunk_table = in_chunks[chunk].Matches;
+
+		for (i = chunk_table->start; i < chunk_table->end; i++)
+			table->first[i] = (unsigned int)table->count + chunk_table->first[i - chunk_table->start];
+
+		memcpy(table->offset + table->count, chunk_table->offset, chunk_table->count * sizeof(unsigned short));
+		memcpy(table->len + table->count, chunk_table->len, chunk_table->count * sizeof(unsigned short));
+		table->count += chunk_table->count;
+		table->chain_steps += chunk_table->chain_steps;
+		table->extension_steps += chunk_table->extension_steps;
+
+		ZX7FreeMatchTable(chunk_table);
+	}
+
+	table->first[in_input_size] = (unsigned int)table->count;
+
+	return table;
+}
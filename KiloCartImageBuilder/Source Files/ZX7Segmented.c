@@ -0,0 +1,183 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Parallel segmented optimal parse for the ZX7 compressor                   */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ZX7Segmented.h"
+#include "ZX7Parallel.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	unsigned char* InputData;
+	size_t InputSize;
+	int MaxOffset;
+	size_t Start;			// First position of the segment
+	size_t End;				// End of the parsed range (segment end + overlap with the next segment)
+	Optimal* Parse;
+} SegmentInfo;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static void SegmentTask(void* inout_context);
+static size_t PreviousPosition(Optimal* in_optimal, size_t in_position);
+static void CopyParseEntry(Optimal* in_destination, Optimal* in_source, size_t in_position);
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates optimal parse by parsing overlapping segments of the input in parallel
+// and stitching them at the boundary position where the stitch costs the least bits.
+// The returned array can be used by ZX7Compress (NULL if there is not enough memory).
+Optimal* ZX7OptimizeSegmented(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, int in_thread_count, int* out_segment_count)
+{
+	SegmentInfo segments[ZX7_MAX_SEGMENT_COUNT];
+	Optimal* optimal;
+	int segment_count;
+	int i;
+	size_t position;
+	size_t path_position;
+	size_t stitch_position;
+	size_t total_bits;
+	long long stitch_cost;
+	long long best_stitch_cost;
+
+	// determine number of segments
+	segment_count = (int)(in_input_size / ZX7_MIN_SEGMENT_LENGTH);
+	if (segment_count > in_thread_count)
+		segment_count = in_thread_count;
+	if (segment_count > ZX7_MAX_SEGMENT_COUNT)
+		segment_count = ZX7_MAX_SEGMENT_COUNT;
+
+	*out_segment_count = (segment_count < 1) ? 1 : segment_count;
+
+	if (segment_count < 2)
+		return ZX7Optimize(in_input_data, in_input_size, in_max_offset);
+
+	// parse segments in parallel (each segment overlaps the next one by the offset window)
+	for (i = 0; i < segment_count; i++)
+	{
+		segments[i].InputData = in_input_data;
+		segments[i].InputSize = in_input_size;
+		segments[i].MaxOffset = in_max_offset;
+		segments[i].Start = in_input_size * i / segment_count;
+		segments[i].End = in_input_size * (i + 1) / segment_count + in_max_offset;
+		if (segments[i].End > in_input_size || i == segment_count - 1)
+			segments[i].End = in_input_size;
+		segments[i].Parse = NULL;
+	}
+
+	ZX7RunParallel(SegmentTask, segments, sizeof(SegmentInfo), segment_count);
+
+	optimal = ZX7AllocateOptimal(in_input_size);
+
+	// a segment can't be parsed if there is not enough memory
+	for (i = 0; i < segment_count && optimal != NULL; i++)
+	{
+		if (segments[i].Parse == NULL)
+		{
+			ZX7FreeOptimal(optimal);
+			optimal = NULL;
+		}
+	}
+
+	if (optimal == NULL)
+	{
+		for (i = 0; i < segment_count; i++)
+			ZX7FreeOptimal(segments[i].Parse);
+
+		return NULL;
+	}
+
+	// stitch segments from the end of the input
+	position = in_input_size - 1;
+	total_bits = 0;
+	for (i = segment_count - 1; i > 0; i--)
+	{
+		// find the cheapest stitch position on the parse path of this segment within the overlapping area
+		stitch_position = segments[i].Start - 1;
+		best_stitch_cost = (long long)segments[i - 1].Parse->bits[stitch_position];
+
+		path_position = position;
+		while (path_position >= segments[i].Start)
+		{
+			if (path_position < segments[i - 1].End)
+			{
+				stitch_cost = (long long)segments[i - 1].Parse->bits[path_position] - (long long)segments[i].Parse->bits[path_position];
+				if (stitch_cost < best_stitch_cost)
+				{
+					best_stitch_cost = stitch_cost;
+					stitch_position = path_position;
+				}
+			}
+
+			path_position = PreviousPosition(segments[i].Parse, path_position);
+		}
+
+		// copy parse path of this segment after the stitch position
+		total_bits += segments[i].Parse->bits[position] - segments[i].Parse->bits[stitch_position];
+
+		path_position = position;
+		while (path_position > stitch_position)
+		{
+			CopyParseEntry(optimal, segments[i].Parse, path_position);
+			path_position = PreviousPosition(segments[i].Parse, path_position);
+		}
+
+		position = stitch_position;
+	}
+
+	// copy parse path of the first segment
+	total_bits += segments[0].Parse->bits[position];
+
+	path_position = position;
+	while (path_position > 0)
+	{
+		CopyParseEntry(optimal, segments[0].Parse, path_position);
+		path_position = PreviousPosition(segments[0].Parse, path_position);
+	}
+
+	// compressor uses the bit count of the last position
+	optimal->bits[in_input_size - 1] = (unsigned int)total_bits;
+
+	for (i = 0; i < segment_count; i++)
+		ZX7FreeOptimal(segments[i].Parse);
+
+	return optimal;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Parses one segment
+static void SegmentTask(void* inout_context)
+{
+	SegmentInfo* segment = (SegmentInfo*)inout_context;
+
+	segment->Parse = ZX7OptimizeRange(segment->InputData, segment->InputSize, segment->MaxOffset, segment->Start, segment->End);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the previous position of the parse path
+static size_t PreviousPosition(Optimal* in_optimal, size_t in_position)
+{
+	return in_position - ((in_optimal->len[in_position] > 0) ? in_optimal->len[in_position] : 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Copies one position of the parse
+static void CopyParseEntry(Optimal* in_destination, Optimal* in_source, size_t in_position)
+{
+	in_destination->bits[in_position] = in_source->bits[in_position];
+	in_destination->offset[in_position] = in_source->offset[in_position];
+	in_destination->len[in_position] = in_source->len[in_position];
+}
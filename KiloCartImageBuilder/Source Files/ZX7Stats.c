@@ -0,0 +1,217 @@
+/*****************************************************************************/
+/* KiloCartImageBuilder - Videoton TV Computer 64k Cart Image Builder        */
+/* Bit accounting and match finder statistics of the ZX7 compressed data     */
+/*                                                                           */
+/* Copyright (C) 2021 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <string.h>
+#include "ZX7Stats.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	unsigned char* Data;
+	size_t Length;
+	size_t Index;
+	int BitMask;
+	int BitByte;
+	bool Overrun;
+} StreamReader;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static int ReadByte(StreamReader* inout_reader);
+static int ReadBit(StreamReader* inout_reader);
+static int GetValueClass(int in_value, int in_class_count);
+static void AddRegionBits(ZX7Stats* inout_stats, size_t in_position, unsigned int in_bits);
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes the compressed stream and counts the bits of its elements. The stream
+// is walked the same way as the loader decompresses it, therefore the statistics
+// are the same for every parse (fast, optimal, segmented or best). Long offsets
+// have in_offset_bits extra bits. Returns false if the stream is invalid.
+bool ZX7CollectStats(unsigned char* in_compressed_data, size_t in_compressed_size, int in_offset_bits, ZX7Stats* out_stats)
+{
+	StreamReader reader;
+	size_t position;
+	unsigned int bits;
+	int zero_count;
+	int length;
+	int offset;
+	int i;
+
+	memset(out_stats, 0, sizeof(ZX7Stats));
+	out_stats->CompressedLength = in_compressed_size;
+
+	if (in_compressed_size == 0)
+		return false;
+
+	reader.Data = in_compressed_data;
+	reader.Length = in_compressed_size;
+	reader.Index = 0;
+	reader.BitMask = 0;
+	reader.BitByte = 0;
+	reader.Overrun = false;
+
+	// first byte is always literal
+	ReadByte(&reader);
+	out_stats->LiteralCount = 1;
+	out_stats->LiteralBits = 8;
+	AddRegionBits(out_stats, 0, 8);
+	position = 1;
+
+	while (!reader.Overrun)
+	{
+		if (ReadBit(&reader) == 0)
+		{
+			// literal
+			ReadByte(&reader);
+			out_stats->LiteralCount++;
+			out_stats->LiteralBits += 8;
+			out_stats->FlagBits++;
+			AddRegionBits(out_stats, position, 1 + 8);
+			position++;
+			continue;
+		}
+
+		// sequence length (Elias-gamma)
+		zero_count = 0;
+		while (ReadBit(&reader) == 0 && !reader.Overrun)
+			zero_count++;
+
+		// end marker
+		if (zero_count >= 16)
+			break;
+
+		length = 1;
+		for (i = 0; i < zero_count; i++)
+			length = (length << 1) | ReadBit(&reader);
+		length++;
+
+		// offset
+		offset = ReadByte(&reader);
+		bits = 1 + 2 * zero_count + 1;
+		out_stats->FlagBits++;
+		out_stats->LengthBits += 2 * (size_t)zero_count + 1;
+
+		if ((offset & 0x80) != 0)
+		{
+			offset &= 0x7f;
+			for (i = 0; i < in_offset_bits; i++)
+				offset |= ReadBit(&reader) << (6 + in_offset_bits - i);
+			offset += 128;
+
+			out_stats->LongOffsetCount++;
+			out_stats->LongOffsetBits += 8 + (size_t)in_offset_bits;
+			bits += 8 + in_offset_bits;
+		}
+		else
+		{
+			out_stats->ShortOffsetCount++;
+			out_stats->ShortOffsetBits += 8;
+			bits += 8;
+		}
+		offset++;
+
+		if ((size_t)offset > position)
+			return false;
+
+		out_stats->SequenceCount++;
+		out_stats->LengthHistogram[GetValueClass(length - 1, ZX7_STATS_LENGTH_CLASS_COUNT)]++;
+		out_stats->OffsetHistogram[GetValueClass(offset, ZX7_STATS_OFFSET_CLASS_COUNT)]++;
+		AddRegionBits(out_stats, position, bits);
+		position += length;
+	}
+
+	out_stats->InputLength = position;
+
+	return !reader.Overrun && position <= MAX_INPUT_SIZE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs the match finder of the optimal parse and stores its work counters
+// (returns false if there is not enough memory)
+bool ZX7CollectMatchFinderStats(unsigned char* in_input_data, size_t in_input_size, int in_max_offset, ZX7Stats* inout_stats)
+{
+	MatchTable* matches;
+
+	matches = ZX7FindMatches(in_input_data, in_input_size, in_max_offset, 0, in_input_size);
+	if (matches == NULL)
+		return false;
+
+	inout_stats->ChainSteps = matches->chain_steps;
+	inout_stats->ExtensionSteps = matches->extension_steps;
+
+	ZX7FreeMatchTable(matches);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads the next byte of the stream
+static int ReadByte(StreamReader* inout_reader)
+{
+	if (inout_reader->Index >= inout_reader->Length)
+	{
+		inout_reader->Overrun = true;
+		return 0;
+	}
+
+	return inout_reader->Data[inout_reader->Index++];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads the next bit (bits are stored in bytes between the data bytes)
+static int ReadBit(StreamReader* inout_reader)
+{
+	int bit;
+
+	if (inout_reader->BitMask == 0)
+	{
+		inout_reader->BitMask = 0x80;
+		inout_reader->BitByte = ReadByte(inout_reader);
+	}
+
+	bit = ((inout_reader->BitByte & inout_reader->BitMask) != 0) ? 1 : 0;
+	inout_reader->BitMask >>= 1;
+
+	return bit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the base 2 logarithm of the value (limited to the class count)
+static int GetValueClass(int in_value, int in_class_count)
+{
+	int value_class = 0;
+
+	while (in_value > 1 && value_class < in_class_count - 1)
+	{
+		in_value >>= 1;
+		value_class++;
+	}
+
+	return value_class;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds the bits of an element to the heat map region of its first input byte
+static void AddRegionBits(ZX7Stats* inout_stats, size_t in_position, unsigned int in_bits)
+{
+	int region = (int)(in_position / ZX7_STATS_REGION_SIZE);
+
+	if (region >= ZX7_STATS_MAX_REGION_COUNT)
+		return;
+
+	inout_stats->RegionBits[region] += in_bits;
+
+	if (region >= inout_stats->RegionCount)
+		inout_stats->RegionCount = region + 1;
+}
@@ -1,53 +1,69 @@
 /* Generated by bin2c, do not edit manually */
 
 /* Contents of file kilocart_loader.bin */
-const long int kilocart_loader_bin_size = 741;
-const unsigned char kilocart_loader_bin[741] = {
+const long int kilocart_loader_bin_size = 1000;
+const unsigned char kilocart_loader_bin[1000] = {
     0x4D, 0x4F, 0x50, 0x53, 0x3A, 0xFC, 0xFF, 0xC3, 0x14, 0xC0, 0x4B, 0x49, 0x4C, 0x4F, 0x43, 0x41,
-    0x52, 0x54, 0x00, 0x01, 0x3E, 0x30, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xD5, 0x21, 0x0A, 0xC2, 0x11,
-    0x05, 0x0C, 0x01, 0xAB, 0x00, 0xED, 0xB0, 0xCD, 0x1D, 0x0C, 0xD1, 0x21, 0xEA, 0xFF, 0x19, 0x22,
-    0x05, 0x0C, 0x21, 0xD3, 0xC2, 0x11, 0x95, 0x0B, 0x01, 0x0A, 0x00, 0xED, 0xB0, 0x2A, 0x35, 0x0B,
-    0x22, 0x9D, 0x0B, 0x21, 0xB5, 0xC2, 0x11, 0x23, 0x0B, 0x01, 0x1E, 0x00, 0xED, 0xB0, 0x3E, 0x00,
-    0x32, 0xB8, 0x0E, 0xCD, 0x89, 0xC0, 0x11, 0x10, 0x00, 0x19, 0x5E, 0x23, 0x56, 0x23, 0x4E, 0x23,
-    0x46, 0x6B, 0x62, 0x11, 0xEF, 0x19, 0xCD, 0x50, 0x0C, 0x21, 0xEF, 0x19, 0x22, 0x20, 0x17, 0x22,
-    0x22, 0x17, 0x3A, 0xB7, 0x0E, 0xB7, 0xCA, 0xA2, 0x0C, 0x3E, 0x0F, 0x32, 0xB6, 0x0E, 0x2A, 0x05,
-    0x0C, 0x3E, 0x20, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xE9, 0x3A, 0xB7, 0x0E, 0xB7, 0x28, 0x0B, 0x2A,
-    0xE1, 0xC2, 0x3E, 0xC0, 0xB4, 0x67, 0x3A, 0xDE, 0xC2, 0xC9, 0x2A, 0xDF, 0xC2, 0x3E, 0xC0, 0xB4,
-    0x67, 0x3A, 0xDD, 0xC2, 0xC9, 0x08, 0xF5, 0xE6, 0x70, 0xFE, 0x50, 0xCA, 0xB3, 0xC0, 0xF1, 0x08,
-    0xC3, 0x95, 0x0B, 0xF1, 0xE5, 0xFE, 0xD3, 0xCA, 0xCD, 0xC0, 0xFE, 0xD1, 0xCA, 0x94, 0xC1, 0xFE,
-    0xD2, 0xCA, 0xBA, 0xC1, 0xFE, 0xD4, 0xCA, 0xE8, 0xC1, 0xE1, 0xC3, 0xAF, 0xC0, 0x3A, 0xB8, 0x0E,
-    0xB7, 0x28, 0x05, 0x3E, 0xEB, 0xC3, 0x01, 0xC2, 0x6B, 0x62, 0xD5, 0x11, 0xF5, 0x0B, 0x7E, 0xFE,
-    0x10, 0x38, 0x02, 0x3E, 0x10, 0x32, 0xF4, 0x0B, 0x47, 0x23, 0x7E, 0xFE, 0x61, 0x38, 0x12, 0xFE,
-    0x7B, 0x30, 0x04, 0xE6, 0xDF, 0x18, 0x0A, 0xFE, 0x90, 0x38, 0x06, 0xFE, 0x99, 0x30, 0x02, 0xD6,
-    0x10, 0x12, 0x13, 0x23, 0x10, 0xE4, 0x3A, 0xF4, 0x0B, 0x47, 0x21, 0xF5, 0x0B, 0x7E, 0x23, 0xFE,
-    0x2E, 0x28, 0x20, 0x10, 0xF8, 0x3A, 0xF4, 0x0B, 0xFE, 0x0D, 0x30, 0x17, 0x5F, 0xC6, 0x04, 0x32,
-    0xF4, 0x0B, 0x3E, 0xF5, 0x83, 0x5F, 0x3E, 0x00, 0xCE, 0x0B, 0x57, 0x21, 0x06, 0xC2, 0x01, 0x04,
-    0x00, 0xED, 0xB0, 0xCD, 0x89, 0xC0, 0x4F, 0xE5, 0x3A, 0xF4, 0x0B, 0x47, 0x11, 0xF5, 0x0B, 0x1A,
-    0xBE, 0x20, 0x41, 0x23, 0x13, 0x10, 0xF8, 0x3E, 0x01, 0x32, 0xB8, 0x0E, 0x21, 0x0A, 0xC2, 0x11,
-    0x05, 0x0C, 0x01, 0xAB, 0x00, 0xED, 0xB0, 0xC1, 0x21, 0x10, 0x00, 0x09, 0x7E, 0x32, 0x0A, 0x0C,
-    0x23, 0x7E, 0x32, 0x0B, 0x0C, 0x23, 0x7E, 0x32, 0x08, 0x0C, 0x32, 0x0F, 0x0C, 0x23, 0x7E, 0x32,
-    0x09, 0x0C, 0x32, 0x10, 0x0C, 0xAF, 0x32, 0x0C, 0x0C, 0x32, 0x6B, 0x0B, 0xD1, 0x11, 0xF4, 0x0B,
-    0xAF, 0xC3, 0x01, 0xC2, 0xE1, 0x11, 0x14, 0x00, 0x19, 0x0D, 0x79, 0xB7, 0x20, 0xA9, 0xD1, 0x3E,
-    0xE9, 0xC3, 0x01, 0xC2, 0x3A, 0xB8, 0x0E, 0xB7, 0x28, 0xF5, 0x3A, 0x0C, 0x0C, 0xFE, 0x10, 0x30,
-    0x14, 0x21, 0x0D, 0x0C, 0x85, 0x6F, 0x8C, 0x95, 0x67, 0x4E, 0x3A, 0x0C, 0x0C, 0x3C, 0x32, 0x0C,
-    0x0C, 0xAF, 0xC3, 0x01, 0xC2, 0x3E, 0xEC, 0xC3, 0x01, 0xC2, 0x3A, 0xB8, 0x0E, 0xB7, 0x28, 0xCF,
-    0x2A, 0x08, 0x0C, 0x7D, 0xB4, 0x28, 0x1C, 0xB7, 0xED, 0x42, 0x30, 0x07, 0xED, 0x4B, 0x08, 0x0C,
-    0x21, 0x00, 0x00, 0x22, 0x08, 0x0C, 0x2A, 0x0A, 0x0C, 0xCD, 0x50, 0x0C, 0x22, 0x0A, 0x0C, 0xAF,
-    0xC3, 0x01, 0xC2, 0x3E, 0xEC, 0xC3, 0x01, 0xC2, 0xAF, 0x32, 0x0A, 0x0C, 0x32, 0x0B, 0x0C, 0x32,
-    0x08, 0x0C, 0x32, 0x0F, 0x0C, 0x32, 0x09, 0x0C, 0x32, 0x10, 0x0C, 0x32, 0xB8, 0x0E, 0xC3, 0x01,
-    0xC2, 0xE1, 0xB7, 0xC3, 0x37, 0x0B, 0x2E, 0x43, 0x41, 0x53, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x52, 0x54, 0x00, 0x01, 0x3E, 0x30, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xD5, 0x21, 0xC7, 0xC2, 0x11,
+    0x05, 0x0C, 0x01, 0xE4, 0x00, 0xED, 0xB0, 0xCD, 0xAE, 0xC0, 0x11, 0x14, 0x00, 0x19, 0x7E, 0xE6,
+    0x08, 0xCC, 0x20, 0x0C, 0xD1, 0x21, 0xEA, 0xFF, 0x19, 0x22, 0x05, 0x0C, 0x21, 0xD4, 0xC3, 0x11,
+    0x95, 0x0B, 0x01, 0x0A, 0x00, 0xED, 0xB0, 0x2A, 0x35, 0x0B, 0x22, 0x9D, 0x0B, 0x21, 0xAB, 0xC3,
+    0x11, 0x23, 0x0B, 0x01, 0x29, 0x00, 0xED, 0xB0, 0x3E, 0x00, 0x32, 0xB8, 0x0E, 0xCD, 0xAE, 0xC0,
+    0x11, 0x10, 0x00, 0x19, 0x5E, 0x23, 0x56, 0x23, 0x4E, 0x23, 0x46, 0x23, 0x7E, 0x32, 0x0D, 0x0C,
+    0xE6, 0x08, 0x20, 0x28, 0x6B, 0x62, 0x11, 0xEF, 0x19, 0xCD, 0x5B, 0x0C, 0x21, 0xEF, 0x19, 0x22,
+    0x20, 0x17, 0x22, 0x22, 0x17, 0x3A, 0xB7, 0x0E, 0xB7, 0xCA, 0xDB, 0x0C, 0x3E, 0x0F, 0x32, 0xB6,
+    0x0E, 0x2A, 0x05, 0x0C, 0x3E, 0x20, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xE9, 0xD5, 0x23, 0x5E, 0x23,
+    0x56, 0x23, 0x7E, 0x23, 0x66, 0x6F, 0xE3, 0xCD, 0x5B, 0x0C, 0xE1, 0xC3, 0x53, 0x0C, 0x3A, 0xB7,
+    0x0E, 0xB7, 0x28, 0x0B, 0x2A, 0xE4, 0xC3, 0x3E, 0xC0, 0xB4, 0x67, 0x3A, 0xE1, 0xC3, 0xC9, 0x2A,
+    0xE2, 0xC3, 0x3E, 0xC0, 0xB4, 0x67, 0x3A, 0xE0, 0xC3, 0xC9, 0x08, 0xF5, 0xE6, 0x70, 0xFE, 0x50,
+    0xCA, 0xD8, 0xC0, 0xF1, 0x08, 0xC3, 0x95, 0x0B, 0xF1, 0xE5, 0xFE, 0xD3, 0xCA, 0xFC, 0xC0, 0xFE,
+    0xD1, 0xCA, 0xD2, 0xC1, 0xFE, 0xD2, 0xCA, 0x1E, 0xC2, 0xFE, 0xD4, 0xCA, 0x4B, 0xC2, 0xFE, 0xDE,
+    0xCA, 0x64, 0xC2, 0xFE, 0xDF, 0xCA, 0x7B, 0xC2, 0xE1, 0xC3, 0xD4, 0xC0, 0x3A, 0xB8, 0x0E, 0xB7,
+    0x28, 0x05, 0x3E, 0xEB, 0xC3, 0xBE, 0xC2, 0x6B, 0x62, 0xD5, 0x11, 0xF5, 0x0B, 0x7E, 0xFE, 0x10,
+    0x38, 0x02, 0x3E, 0x10, 0x32, 0xF4, 0x0B, 0x47, 0x23, 0x7E, 0xFE, 0x61, 0x38, 0x12, 0xFE, 0x7B,
+    0x30, 0x04, 0xE6, 0xDF, 0x18, 0x0A, 0xFE, 0x90, 0x38, 0x06, 0xFE, 0x99, 0x30, 0x02, 0xD6, 0x10,
+    0x12, 0x13, 0x23, 0x10, 0xE4, 0x3A, 0xF4, 0x0B, 0x47, 0x21, 0xF5, 0x0B, 0x7E, 0x23, 0xFE, 0x2E,
+    0x28, 0x20, 0x10, 0xF8, 0x3A, 0xF4, 0x0B, 0xFE, 0x0D, 0x30, 0x17, 0x5F, 0xC6, 0x04, 0x32, 0xF4,
+    0x0B, 0x3E, 0xF5, 0x83, 0x5F, 0x3E, 0x00, 0xCE, 0x0B, 0x57, 0x21, 0xC3, 0xC2, 0x01, 0x04, 0x00,
+    0xED, 0xB0, 0xCD, 0xAE, 0xC0, 0x4F, 0xE5, 0x3A, 0xF4, 0x0B, 0x47, 0x11, 0xF5, 0x0B, 0x1A, 0xBE,
+    0x20, 0x50, 0x23, 0x13, 0x10, 0xF8, 0x3E, 0x01, 0x32, 0xB8, 0x0E, 0x21, 0xC7, 0xC2, 0x11, 0x05,
+    0x0C, 0x01, 0xE4, 0x00, 0xED, 0xB0, 0xC1, 0x21, 0x10, 0x00, 0x09, 0x7E, 0x32, 0x0A, 0x0C, 0x23,
+    0x7E, 0x07, 0x07, 0xE6, 0x03, 0x32, 0x07, 0x0C, 0x3E, 0xC0, 0xB6, 0x32, 0x0B, 0x0C, 0x23, 0x7E,
+    0x32, 0x08, 0x0C, 0x32, 0x12, 0x0C, 0x23, 0x7E, 0x32, 0x09, 0x0C, 0x32, 0x13, 0x0C, 0x23, 0x7E,
+    0x32, 0x0D, 0x0C, 0xAF, 0x32, 0x0C, 0x0C, 0x32, 0x6B, 0x0B, 0xD1, 0x11, 0xF4, 0x0B, 0xAF, 0xC3,
+    0xBE, 0xC2, 0xE1, 0x11, 0x19, 0x00, 0x19, 0x0D, 0x79, 0xB7, 0x20, 0x9A, 0xD1, 0x3E, 0xE9, 0xC3,
+    0xBE, 0xC2, 0x3A, 0xB8, 0x0E, 0xB7, 0x28, 0xF5, 0x3A, 0x0C, 0x0C, 0xFE, 0x10, 0x30, 0x14, 0x21,
+    0x10, 0x0C, 0x85, 0x6F, 0x8C, 0x95, 0x67, 0x4E, 0x3A, 0x0C, 0x0C, 0x3C, 0x32, 0x0C, 0x0C, 0xAF,
+    0xC3, 0xBE, 0xC2, 0x2A, 0x08, 0x0C, 0x7D, 0xB4, 0x28, 0x1F, 0xC5, 0xD5, 0x11, 0x0E, 0x0C, 0x01,
+    0x01, 0x00, 0xCD, 0x8D, 0xC2, 0xD1, 0xC1, 0xB7, 0xC2, 0xBE, 0xC2, 0x2A, 0x08, 0x0C, 0x2B, 0x22,
+    0x08, 0x0C, 0x21, 0x0E, 0x0C, 0x4E, 0xC3, 0xBE, 0xC2, 0x3E, 0xEC, 0xC3, 0xBE, 0xC2, 0x3A, 0xB8,
+    0x0E, 0xB7, 0x28, 0xA9, 0x2A, 0x08, 0x0C, 0x7D, 0xB4, 0x28, 0x1B, 0xB7, 0xED, 0x42, 0x30, 0x07,
+    0xED, 0x4B, 0x08, 0x0C, 0x21, 0x00, 0x00, 0xE5, 0xCD, 0x8D, 0xC2, 0xE1, 0xB7, 0xC2, 0xBE, 0xC2,
+    0x22, 0x08, 0x0C, 0xC3, 0xBE, 0xC2, 0x3E, 0xEC, 0xC3, 0xBE, 0xC2, 0xAF, 0x32, 0x0A, 0x0C, 0x32,
+    0x0B, 0x0C, 0x32, 0x08, 0x0C, 0x32, 0x12, 0x0C, 0x32, 0x09, 0x0C, 0x32, 0x13, 0x0C, 0x32, 0xB8,
+    0x0E, 0xC3, 0xBE, 0xC2, 0x3A, 0xB8, 0x0E, 0xB7, 0xCA, 0xCD, 0xC1, 0x3A, 0x0D, 0x0C, 0xE6, 0x02,
+    0x3E, 0xE6, 0xCA, 0xBE, 0xC2, 0xCD, 0xB9, 0x0C, 0xC3, 0xBE, 0xC2, 0x3A, 0xB8, 0x0E, 0xB7, 0xCA,
+    0xCD, 0xC1, 0x21, 0x0D, 0x0C, 0x7E, 0xF6, 0x04, 0x77, 0xAF, 0xC3, 0xBE, 0xC2, 0xAF, 0xB0, 0xB1,
+    0xC8, 0x3A, 0x0D, 0x0C, 0xE6, 0x04, 0x3E, 0x30, 0x28, 0x0E, 0x21, 0x00, 0x00, 0x39, 0x7C, 0xE6,
+    0xC0, 0xFE, 0x80, 0x3E, 0xE7, 0xC8, 0x3E, 0x10, 0x32, 0x0F, 0x0C, 0x32, 0x03, 0x00, 0xD3, 0x02,
+    0x2A, 0x0A, 0x0C, 0xCD, 0x67, 0x0C, 0x22, 0x0A, 0x0C, 0xAF, 0xC9, 0x3E, 0xE6, 0xC9, 0xE1, 0xB7,
+    0xC3, 0x3A, 0x0B, 0x2E, 0x43, 0x41, 0x53, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x30, 0x00, 0x01, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x3E, 0x70, 0x32, 0x03, 0x00, 0xD3, 0x02, 0x3A, 0xB7, 0x0E, 0xB7, 0x20, 0x1E, 0x21,
     0x00, 0x17, 0xE5, 0xDD, 0xE1, 0x01, 0xEF, 0x02, 0x11, 0x01, 0x17, 0x36, 0x00, 0xED, 0xB0, 0x21,
     0x5B, 0xFB, 0x11, 0x08, 0x00, 0x01, 0x27, 0x00, 0xED, 0xB0, 0xCD, 0x10, 0xDE, 0x3E, 0x30, 0x32,
-    0x03, 0x00, 0xD3, 0x02, 0xC9, 0x78, 0xB1, 0xC8, 0x3E, 0x30, 0x32, 0x03, 0x00, 0xD3, 0x02, 0x7C,
-    0xCB, 0x3F, 0xCB, 0x3F, 0xCB, 0x3F, 0xCB, 0x3F, 0xCB, 0x3F, 0xCB, 0x3F, 0x32, 0x07, 0x0C, 0xCD,
-    0x94, 0x0C, 0x3E, 0xC0, 0xB4, 0x67, 0xCD, 0x78, 0x0C, 0x3A, 0xFC, 0xFF, 0xC9, 0xED, 0xA0, 0xE0,
-    0x7C, 0xFE, 0xFF, 0x38, 0xF8, 0x7D, 0xFE, 0xFC, 0x38, 0xF3, 0x3A, 0x07, 0x0C, 0x3C, 0x32, 0x07,
-    0x0C, 0xCD, 0x94, 0x0C, 0x21, 0x07, 0xC0, 0x18, 0xE4, 0xE5, 0xF5, 0x3A, 0x07, 0x0C, 0x21, 0xFC,
-    0xFF, 0xB5, 0x6F, 0x7E, 0xF1, 0xE1, 0xC9, 0x3E, 0x70, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xFB, 0x2A,
-    0x22, 0x17, 0xC3, 0x23, 0xDE, 0xE3, 0x7E, 0x23, 0xE3, 0x08, 0xF5, 0x3A, 0x03, 0x00, 0xF5, 0x3E,
-    0x30, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xC3, 0xA5, 0xC0, 0x08, 0xF1, 0x32, 0x03, 0x00, 0xD3, 0x02,
-    0xF1, 0x08, 0xC9, 0x3E, 0x70, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xC3, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00
+    0x03, 0x00, 0xD3, 0x02, 0xC9, 0x3E, 0x70, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xE9, 0x7C, 0x07, 0x07,
+    0xE6, 0x03, 0x32, 0x07, 0x0C, 0x3E, 0xC0, 0xB4, 0x67, 0x78, 0xB1, 0xC8, 0x3A, 0x0F, 0x0C, 0x32,
+    0x03, 0x00, 0xD3, 0x02, 0xCD, 0xAB, 0x0C, 0xCD, 0x91, 0x0C, 0xCD, 0x7F, 0x0C, 0x3A, 0xFC, 0xFF,
+    0xC9, 0xED, 0xA0, 0xE0, 0x7C, 0xFE, 0xFF, 0x38, 0xF8, 0x7D, 0xFE, 0xFC, 0x38, 0xF3, 0xCD, 0x91,
+    0x0C, 0x18, 0xEE, 0xF5, 0x7C, 0xFE, 0xFF, 0x38, 0x12, 0x7D, 0xFE, 0xFC, 0x38, 0x0D, 0x3A, 0x07,
+    0x0C, 0x3C, 0x32, 0x07, 0x0C, 0xCD, 0xAB, 0x0C, 0x21, 0x07, 0xC0, 0xF1, 0xC9, 0xE5, 0xF5, 0x3A,
+    0x07, 0x0C, 0x21, 0xFC, 0xFF, 0xB5, 0x6F, 0x7E, 0xF1, 0xE1, 0xC9, 0x2A, 0x4A, 0x0B, 0xE5, 0x3A,
+    0x07, 0x0C, 0x21, 0xFC, 0xFF, 0xB5, 0x6F, 0x22, 0x4A, 0x0B, 0x7E, 0x21, 0xD1, 0x0C, 0xE5, 0x2A,
+    0x0A, 0x0C, 0xE9, 0xE1, 0x22, 0x4A, 0x0B, 0xF5, 0x3A, 0xFC, 0xFF, 0xF1, 0xC9, 0x3E, 0x70, 0x32,
+    0x03, 0x00, 0xD3, 0x02, 0xFB, 0x2A, 0x22, 0x17, 0xC3, 0x23, 0xDE, 0xE3, 0x7E, 0x23, 0xE3, 0x08,
+    0xF5, 0x3A, 0x03, 0x00, 0xF5, 0x3E, 0x30, 0x32, 0x03, 0x00, 0xD3, 0x02, 0x3A, 0xFC, 0xFF, 0xC3,
+    0xCA, 0xC0, 0x08, 0xF1, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xE5, 0x2A, 0x4A, 0x0B, 0x7E, 0xE1, 0xF1,
+    0x08, 0xC9, 0xFC, 0xFF, 0x3E, 0x70, 0x32, 0x03, 0x00, 0xD3, 0x02, 0xC3, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
@@ -1,6 +1,60 @@
-@sjasmplus.exe -Wno-rdlow --raw=kilocart_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 kilocart.a80
-@sjasmplus.exe -Wno-rdlow --raw=kilocart_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_stream_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=1 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_async_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=1 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_async_stream_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=1 -DASYNC_ENABLED=1 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_stream_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=1 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_async_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=1 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_async_stream_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=1 -DASYNC_ENABLED=1 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=0 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_lzb_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=1 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_lzb_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=1 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_lzb_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=1 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_lzb_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=1 -DFILTER_ENABLED=0 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_filter_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=0 -DFILTER_ENABLED=1 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_filter_lzb_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=1 -DFILTER_ENABLED=1 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_filter_lzb_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=1 -DNATIVE_ENABLED=1 -DLZB_ENABLED=1 -DFILTER_ENABLED=1 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_filter_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=0 -DFILTER_ENABLED=1 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_filter_lzb_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=0 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=1 -DFILTER_ENABLED=1 kilocart.a80
+@sjasmplus.exe -Wno-rdlow --raw=kilocart_core_filter_lzb_decomp_loader.bin --syntax=abf -DDECOMPRESSOR_ENABLED=1 -DSTREAM_ENABLED=0 -DASYNC_ENABLED=0 -DXIP_ENABLED=0 -DNATIVE_ENABLED=0 -DLZB_ENABLED=1 -DFILTER_ENABLED=1 kilocart.a80
 @bin2c -o kilocart_loader.c kilocart_loader.bin 
 @bin2c -o kilocart_decomp_loader.c kilocart_decomp_loader.bin 
+@bin2c -o kilocart_stream_loader.c kilocart_stream_loader.bin 
+@bin2c -o kilocart_async_loader.c kilocart_async_loader.bin 
+@bin2c -o kilocart_async_stream_loader.c kilocart_async_stream_loader.bin 
+@bin2c -o kilocart_core_loader.c kilocart_core_loader.bin 
+@bin2c -o kilocart_core_decomp_loader.c kilocart_core_decomp_loader.bin 
+@bin2c -o kilocart_core_stream_loader.c kilocart_core_stream_loader.bin 
+@bin2c -o kilocart_core_async_loader.c kilocart_core_async_loader.bin 
+@bin2c -o kilocart_core_async_stream_loader.c kilocart_core_async_stream_loader.bin 
+@bin2c -o kilocart_lzb_loader.c kilocart_lzb_loader.bin 
+@bin2c -o kilocart_lzb_decomp_loader.c kilocart_lzb_decomp_loader.bin 
+@bin2c -o kilocart_core_lzb_loader.c kilocart_core_lzb_loader.bin 
+@bin2c -o kilocart_core_lzb_decomp_loader.c kilocart_core_lzb_decomp_loader.bin 
+@bin2c -o kilocart_filter_decomp_loader.c kilocart_filter_decomp_loader.bin 
+@bin2c -o kilocart_filter_lzb_loader.c kilocart_filter_lzb_loader.bin 
+@bin2c -o kilocart_filter_lzb_decomp_loader.c kilocart_filter_lzb_decomp_loader.bin 
+@bin2c -o kilocart_core_filter_decomp_loader.c kilocart_core_filter_decomp_loader.bin 
+@bin2c -o kilocart_core_filter_lzb_loader.c kilocart_core_filter_lzb_loader.bin 
+@bin2c -o kilocart_core_filter_lzb_decomp_loader.c kilocart_core_filter_lzb_decomp_loader.bin 
 @copy kilocart_loader.c "../KiloCartImageBuilder/Source Files/kilocart_loader.c"
-@copy kilocart_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_decomp_loader.c"
\ No newline at end of file
+@copy kilocart_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_decomp_loader.c"
+@copy kilocart_stream_loader.c "../KiloCartImageBuilder/Source Files/kilocart_stream_loader.c"
+@copy kilocart_async_loader.c "../KiloCartImageBuilder/Source Files/kilocart_async_loader.c"
+@copy kilocart_async_stream_loader.c "../KiloCartImageBuilder/Source Files/kilocart_async_stream_loader.c"
+@copy kilocart_core_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_loader.c"
+@copy kilocart_core_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_decomp_loader.c"
+@copy kilocart_core_stream_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_stream_loader.c"
+@copy kilocart_core_async_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_async_loader.c"
+@copy kilocart_core_async_stream_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_async_stream_loader.c"
+@copy kilocart_lzb_loader.c "../KiloCartImageBuilder/Source Files/kilocart_lzb_loader.c"
+@copy kilocart_lzb_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_lzb_decomp_loader.c"
+@copy kilocart_core_lzb_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_lzb_loader.c"
+@copy kilocart_core_lzb_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_lzb_decomp_loader.c"
+@copy kilocart_filter_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_filter_decomp_loader.c"
+@copy kilocart_filter_lzb_loader.c "../KiloCartImageBuilder/Source Files/kilocart_filter_lzb_loader.c"
+@copy kilocart_filter_lzb_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_filter_lzb_decomp_loader.c"
+@copy kilocart_core_filter_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_filter_decomp_loader.c"
+@copy kilocart_core_filter_lzb_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_filter_lzb_loader.c"
+@copy kilocart_core_filter_lzb_decomp_loader.c "../KiloCartImageBuilder/Source Files/kilocart_core_filter_lzb_decomp_loader.c"
\ No newline at end of file